@@ -0,0 +1,1246 @@
+#include "adt_pattern.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ADT_PATTERN_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define ADT_PATTERN_NEON
+#endif
+
+
+
+// Pattern key, set once before any threads
+static uint64_t u64PatternStep = 1;
+static uint64_t u64PatternSeed = 0;
+static uint8_t u8PatternRandom = 0;
+static uint8_t u8PatternNonTemporal = 0;
+static uint8_t u8PatternSectors = 0;
+static uint64_t u64PatternRunId = 0;
+static uint32_t u32PatternPass = 0;
+
+
+
+// Reference kernel, everything else must produce exactly this
+static void ADT_FillScalar(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+			   uint64_t u64Step, uint64_t u64Seed)
+{
+  uint64_t* pu64Mem = (uint64_t*)pBufMem;
+  uint64_t i;
+
+  for (i = 0; i < u64Words; i++)
+  {
+    pu64Mem[i] = u64StartValue ^ u64Seed;
+    u64StartValue += u64Step;
+  }
+}
+
+
+
+static uint64_t u64ADT_VerifyScalar(const void* pBufMem, uint64_t u64Words,
+				    uint64_t u64StartValue, uint64_t u64Step,
+				    uint64_t u64Seed)
+{
+  const uint64_t* pu64Mem = (const uint64_t*)pBufMem;
+  uint64_t i;
+
+  for (i = 0; i < u64Words; i++)
+  {
+    if (pu64Mem[i] != (u64StartValue ^ u64Seed))
+    {
+      break;
+    }
+    u64StartValue += u64Step;
+  }
+
+  return i;
+}
+
+
+
+// Random family runs each value through Philox2x32. Every round is a
+// bijection of the 64 bit word, so distinct values never collide and
+// nothing dedups, but the output is as good as incompressible. Only
+// 32x32->64 multiplies are needed, which every vector unit has.
+#define ADT_PHILOX_ROUNDS 10
+#define ADT_PHILOX_MULTIPLIER ((uint64_t)0xD256D193)
+#define ADT_PHILOX_KEY_BUMP ((uint32_t)0x9E3779B9)
+
+static inline uint32_t u32ADT_PhiloxKey(uint64_t u64Seed, uint32_t u32Round)
+{
+  return ((uint32_t)(u64Seed ^ (u64Seed >> 32)) + (u32Round * ADT_PHILOX_KEY_BUMP));
+}
+
+static inline uint64_t u64ADT_Philox(uint64_t u64Value, uint64_t u64Seed)
+{
+  uint64_t u64Product = 0;
+  uint32_t i;
+
+  u64Value ^= u64Seed;
+
+  for (i = 0; i < ADT_PHILOX_ROUNDS; i++)
+  {
+    // Low half gets multiplied, high half of the product xored
+    // with the old high half and the round key, halves swapped.
+    u64Product = (u64Value & 0xFFFFFFFF) * ADT_PHILOX_MULTIPLIER;
+    u64Value = (((u64Product << 32) | (u64Product >> 32)) ^ (u64Value >> 32) ^
+		u32ADT_PhiloxKey(u64Seed, i));
+  }
+
+  return u64Value;
+}
+
+
+
+static void ADT_FillRandomScalar(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+				 uint64_t u64Step, uint64_t u64Seed)
+{
+  uint64_t* pu64Mem = (uint64_t*)pBufMem;
+  uint64_t i;
+
+  for (i = 0; i < u64Words; i++)
+  {
+    pu64Mem[i] = u64ADT_Philox(u64StartValue, u64Seed);
+    u64StartValue += u64Step;
+  }
+}
+
+
+
+static uint64_t u64ADT_VerifyRandomScalar(const void* pBufMem, uint64_t u64Words,
+					  uint64_t u64StartValue, uint64_t u64Step,
+					  uint64_t u64Seed)
+{
+  const uint64_t* pu64Mem = (const uint64_t*)pBufMem;
+  uint64_t i;
+
+  for (i = 0; i < u64Words; i++)
+  {
+    if (pu64Mem[i] != u64ADT_Philox(u64StartValue, u64Seed))
+    {
+      break;
+    }
+    u64StartValue += u64Step;
+  }
+
+  return i;
+}
+
+
+
+// Scalar word for the heads and tails of the vector kernels
+#define ADT_WORD_PLAIN(V) ((V) ^ u64Seed)
+#define ADT_WORD_RANDOM(V) u64ADT_Philox((V), u64Seed)
+
+
+
+static uint8_t bADT_AlwaysSupported(void)
+{
+  return 1;
+}
+
+
+
+#ifdef ADT_PATTERN_X86
+
+// Vector kernels first go scalar until the vector alignment,
+// which the non-temporal stores need, and finish the tail scalar.
+// WORD and VWORD turn a value into the stored word, plain or random.
+
+#define ADT_FILL_HEAD(ALIGN, WORD)					\
+  while ((u64Words > 0) && (((uintptr_t)pu64Mem) & ((ALIGN) - 1)))	\
+  {									\
+    *(pu64Mem++) = WORD(u64StartValue);					\
+    u64StartValue += u64Step;						\
+    u64Words--;								\
+  }
+
+#define ADT_FILL_TAIL(WORD)			\
+  while (u64Words > 0)				\
+  {						\
+    *(pu64Mem++) = WORD(u64StartValue);		\
+    u64StartValue += u64Step;			\
+    u64Words--;					\
+  }
+
+#define ADT_FILL_SSE2_BODY(STORE, WORD, VWORD)				\
+  uint64_t* pu64Mem = (uint64_t*)pBufMem;				\
+  __m128i xV0, xV1, xV2, xV3, xStep, xSeed;				\
+  ADT_FILL_HEAD(16, WORD);						\
+  xStep = _mm_set1_epi64x(8 * u64Step);					\
+  xSeed = _mm_set1_epi64x(u64Seed);					\
+  xV0 = _mm_set_epi64x(u64StartValue + u64Step, u64StartValue);	\
+  xV1 = _mm_add_epi64(xV0, _mm_set1_epi64x(2 * u64Step));		\
+  xV2 = _mm_add_epi64(xV0, _mm_set1_epi64x(4 * u64Step));		\
+  xV3 = _mm_add_epi64(xV0, _mm_set1_epi64x(6 * u64Step));		\
+  while (u64Words >= 8)							\
+  {									\
+    STORE((__m128i*)(pu64Mem + 0), VWORD(xV0));				\
+    STORE((__m128i*)(pu64Mem + 2), VWORD(xV1));				\
+    STORE((__m128i*)(pu64Mem + 4), VWORD(xV2));				\
+    STORE((__m128i*)(pu64Mem + 6), VWORD(xV3));				\
+    xV0 = _mm_add_epi64(xV0, xStep);					\
+    xV1 = _mm_add_epi64(xV1, xStep);					\
+    xV2 = _mm_add_epi64(xV2, xStep);					\
+    xV3 = _mm_add_epi64(xV3, xStep);					\
+    pu64Mem += 8;							\
+    u64StartValue += 8 * u64Step;					\
+    u64Words -= 8;							\
+  }									\
+  ADT_FILL_TAIL(WORD);
+
+#define ADT_FILL_AVX2_BODY(STORE, WORD, VWORD)				\
+  uint64_t* pu64Mem = (uint64_t*)pBufMem;				\
+  __m256i xV0, xV1, xV2, xV3, xStep, xSeed;				\
+  ADT_FILL_HEAD(32, WORD);						\
+  xStep = _mm256_set1_epi64x(16 * u64Step);				\
+  xSeed = _mm256_set1_epi64x(u64Seed);					\
+  xV0 = _mm256_set_epi64x(u64StartValue + (3 * u64Step),		\
+			  u64StartValue + (2 * u64Step),		\
+			  u64StartValue + u64Step, u64StartValue);	\
+  xV1 = _mm256_add_epi64(xV0, _mm256_set1_epi64x(4 * u64Step));	\
+  xV2 = _mm256_add_epi64(xV0, _mm256_set1_epi64x(8 * u64Step));	\
+  xV3 = _mm256_add_epi64(xV0, _mm256_set1_epi64x(12 * u64Step));	\
+  while (u64Words >= 16)						\
+  {									\
+    STORE((__m256i*)(pu64Mem + 0), VWORD(xV0));				\
+    STORE((__m256i*)(pu64Mem + 4), VWORD(xV1));				\
+    STORE((__m256i*)(pu64Mem + 8), VWORD(xV2));				\
+    STORE((__m256i*)(pu64Mem + 12), VWORD(xV3));			\
+    xV0 = _mm256_add_epi64(xV0, xStep);					\
+    xV1 = _mm256_add_epi64(xV1, xStep);					\
+    xV2 = _mm256_add_epi64(xV2, xStep);					\
+    xV3 = _mm256_add_epi64(xV3, xStep);					\
+    pu64Mem += 16;							\
+    u64StartValue += 16 * u64Step;					\
+    u64Words -= 16;							\
+  }									\
+  ADT_FILL_TAIL(WORD);
+
+#define ADT_FILL_AVX512_BODY(STORE, WORD, VWORD)			\
+  uint64_t* pu64Mem = (uint64_t*)pBufMem;				\
+  __m512i xV0, xV1, xV2, xV3, xStep, xSeed;				\
+  ADT_FILL_HEAD(64, WORD);						\
+  xStep = _mm512_set1_epi64(32 * u64Step);				\
+  xSeed = _mm512_set1_epi64(u64Seed);					\
+  xV0 = _mm512_add_epi64(_mm512_set1_epi64(u64StartValue),		\
+			 _mm512_set_epi64(7 * u64Step, 6 * u64Step,	\
+					  5 * u64Step, 4 * u64Step,	\
+					  3 * u64Step, 2 * u64Step,	\
+					  u64Step, 0));			\
+  xV1 = _mm512_add_epi64(xV0, _mm512_set1_epi64(8 * u64Step));		\
+  xV2 = _mm512_add_epi64(xV0, _mm512_set1_epi64(16 * u64Step));	\
+  xV3 = _mm512_add_epi64(xV0, _mm512_set1_epi64(24 * u64Step));	\
+  while (u64Words >= 32)						\
+  {									\
+    STORE((void*)(pu64Mem + 0), VWORD(xV0));				\
+    STORE((void*)(pu64Mem + 8), VWORD(xV1));				\
+    STORE((void*)(pu64Mem + 16), VWORD(xV2));				\
+    STORE((void*)(pu64Mem + 24), VWORD(xV3));				\
+    xV0 = _mm512_add_epi64(xV0, xStep);					\
+    xV1 = _mm512_add_epi64(xV1, xStep);					\
+    xV2 = _mm512_add_epi64(xV2, xStep);					\
+    xV3 = _mm512_add_epi64(xV3, xStep);					\
+    pu64Mem += 32;							\
+    u64StartValue += 32 * u64Step;					\
+    u64Words -= 32;							\
+  }									\
+  ADT_FILL_TAIL(WORD);
+
+
+
+// Philox rounds on vectors. Halves are swapped with a shuffle
+// (rotate on avx512) instead of shift and or, as they don't overlap.
+__attribute__((target("sse2")))
+static inline __m128i xADT_PhiloxSse2(__m128i xV, __m128i xSeed, const __m128i* pxKeys)
+{
+  __m128i xMul = _mm_set1_epi64x(ADT_PHILOX_MULTIPLIER);
+  __m128i xProduct;
+  uint32_t i;
+
+  xV = _mm_xor_si128(xV, xSeed);
+
+  for (i = 0; i < ADT_PHILOX_ROUNDS; i++)
+  {
+    xProduct = _mm_mul_epu32(xV, xMul);
+    xV = _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi32(xProduct, 0xB1),
+				     _mm_srli_epi64(xV, 32)), pxKeys[i]);
+  }
+
+  return xV;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i xADT_PhiloxAvx2(__m256i xV, __m256i xSeed, const __m256i* pxKeys)
+{
+  __m256i xMul = _mm256_set1_epi64x(ADT_PHILOX_MULTIPLIER);
+  __m256i xProduct;
+  uint32_t i;
+
+  xV = _mm256_xor_si256(xV, xSeed);
+
+  for (i = 0; i < ADT_PHILOX_ROUNDS; i++)
+  {
+    xProduct = _mm256_mul_epu32(xV, xMul);
+    xV = _mm256_xor_si256(_mm256_xor_si256(_mm256_shuffle_epi32(xProduct, 0xB1),
+					   _mm256_srli_epi64(xV, 32)), pxKeys[i]);
+  }
+
+  return xV;
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i xADT_PhiloxAvx512(__m512i xV, __m512i xSeed, const __m512i* pxKeys)
+{
+  __m512i xMul = _mm512_set1_epi64(ADT_PHILOX_MULTIPLIER);
+  __m512i xProduct;
+  uint32_t i;
+
+  xV = _mm512_xor_si512(xV, xSeed);
+
+  for (i = 0; i < ADT_PHILOX_ROUNDS; i++)
+  {
+    xProduct = _mm512_mul_epu32(xV, xMul);
+    xV = _mm512_ternarylogic_epi64(_mm512_ror_epi64(xProduct, 32),
+				   _mm512_srli_epi64(xV, 32), pxKeys[i], 0x96);
+  }
+
+  return xV;
+}
+
+#define ADT_SSE2_PLAIN(V) _mm_xor_si128((V), xSeed)
+#define ADT_SSE2_RANDOM(V) xADT_PhiloxSse2((V), xSeed, axKeys)
+#define ADT_AVX2_PLAIN(V) _mm256_xor_si256((V), xSeed)
+#define ADT_AVX2_RANDOM(V) xADT_PhiloxAvx2((V), xSeed, axKeys)
+#define ADT_AVX512_PLAIN(V) _mm512_xor_si512((V), xSeed)
+#define ADT_AVX512_RANDOM(V) xADT_PhiloxAvx512((V), xSeed, axKeys)
+
+#define ADT_PHILOX_KEYS(TYPE, SET1)					\
+  TYPE axKeys[ADT_PHILOX_ROUNDS];					\
+  uint32_t u32Round;							\
+  for (u32Round = 0; u32Round < ADT_PHILOX_ROUNDS; u32Round++)		\
+  {									\
+    axKeys[u32Round] = SET1((uint64_t)u32ADT_PhiloxKey(u64Seed, u32Round)); \
+  }
+
+
+
+__attribute__((target("sse2")))
+static void ADT_FillSse2(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+			 uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_FILL_SSE2_BODY(_mm_store_si128, ADT_WORD_PLAIN, ADT_SSE2_PLAIN);
+}
+
+__attribute__((target("sse2")))
+static void ADT_FillSse2Nt(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+			   uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_FILL_SSE2_BODY(_mm_stream_si128, ADT_WORD_PLAIN, ADT_SSE2_PLAIN);
+  _mm_sfence();
+}
+
+__attribute__((target("sse2")))
+static void ADT_FillRandomSse2(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+			       uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_PHILOX_KEYS(__m128i, _mm_set1_epi64x);
+  ADT_FILL_SSE2_BODY(_mm_store_si128, ADT_WORD_RANDOM, ADT_SSE2_RANDOM);
+}
+
+__attribute__((target("sse2")))
+static void ADT_FillRandomSse2Nt(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+				 uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_PHILOX_KEYS(__m128i, _mm_set1_epi64x);
+  ADT_FILL_SSE2_BODY(_mm_stream_si128, ADT_WORD_RANDOM, ADT_SSE2_RANDOM);
+  _mm_sfence();
+}
+
+__attribute__((target("avx2")))
+static void ADT_FillAvx2(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+			 uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_FILL_AVX2_BODY(_mm256_store_si256, ADT_WORD_PLAIN, ADT_AVX2_PLAIN);
+}
+
+__attribute__((target("avx2")))
+static void ADT_FillAvx2Nt(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+			   uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_FILL_AVX2_BODY(_mm256_stream_si256, ADT_WORD_PLAIN, ADT_AVX2_PLAIN);
+  _mm_sfence();
+}
+
+__attribute__((target("avx2")))
+static void ADT_FillRandomAvx2(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+			       uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_PHILOX_KEYS(__m256i, _mm256_set1_epi64x);
+  ADT_FILL_AVX2_BODY(_mm256_store_si256, ADT_WORD_RANDOM, ADT_AVX2_RANDOM);
+}
+
+__attribute__((target("avx2")))
+static void ADT_FillRandomAvx2Nt(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+				 uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_PHILOX_KEYS(__m256i, _mm256_set1_epi64x);
+  ADT_FILL_AVX2_BODY(_mm256_stream_si256, ADT_WORD_RANDOM, ADT_AVX2_RANDOM);
+  _mm_sfence();
+}
+
+__attribute__((target("avx512f")))
+static void ADT_FillAvx512(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+			   uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_FILL_AVX512_BODY(_mm512_store_si512, ADT_WORD_PLAIN, ADT_AVX512_PLAIN);
+}
+
+__attribute__((target("avx512f")))
+static void ADT_FillAvx512Nt(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+			     uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_FILL_AVX512_BODY(_mm512_stream_si512, ADT_WORD_PLAIN, ADT_AVX512_PLAIN);
+  _mm_sfence();
+}
+
+__attribute__((target("avx512f")))
+static void ADT_FillRandomAvx512(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+				 uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_PHILOX_KEYS(__m512i, _mm512_set1_epi64);
+  ADT_FILL_AVX512_BODY(_mm512_store_si512, ADT_WORD_RANDOM, ADT_AVX512_RANDOM);
+}
+
+__attribute__((target("avx512f")))
+static void ADT_FillRandomAvx512Nt(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+				   uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_PHILOX_KEYS(__m512i, _mm512_set1_epi64);
+  ADT_FILL_AVX512_BODY(_mm512_stream_si512, ADT_WORD_RANDOM, ADT_AVX512_RANDOM);
+  _mm_sfence();
+}
+
+
+
+// Verifiers xor a block of vectors against the expected values
+// and only when something is off, pinpoint the word with scalar.
+#define ADT_VERIFY_TAIL(DONE, SCALAR)					\
+  return ((DONE) + SCALAR(pu64Mem, u64Words, u64StartValue,		\
+			  u64Step, u64Seed));
+
+#define ADT_VERIFY_SSE2_BODY(VWORD, SCALAR)				\
+  const uint64_t* pu64Mem = (const uint64_t*)pBufMem;			\
+  uint64_t u64Done = 0;							\
+  __m128i xE0, xE1, xE2, xE3, xStep, xSeed, xDiff, xZero;		\
+  xZero = _mm_setzero_si128();						\
+  xStep = _mm_set1_epi64x(8 * u64Step);					\
+  xSeed = _mm_set1_epi64x(u64Seed);					\
+  xE0 = _mm_set_epi64x(u64StartValue + u64Step, u64StartValue);	\
+  xE1 = _mm_add_epi64(xE0, _mm_set1_epi64x(2 * u64Step));		\
+  xE2 = _mm_add_epi64(xE0, _mm_set1_epi64x(4 * u64Step));		\
+  xE3 = _mm_add_epi64(xE0, _mm_set1_epi64x(6 * u64Step));		\
+  while (u64Words >= 8)							\
+  {									\
+    xDiff = _mm_or_si128(						\
+      _mm_or_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i*)(pu64Mem + 0)), VWORD(xE0)), \
+		   _mm_xor_si128(_mm_loadu_si128((const __m128i*)(pu64Mem + 2)), VWORD(xE1))), \
+      _mm_or_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i*)(pu64Mem + 4)), VWORD(xE2)), \
+		   _mm_xor_si128(_mm_loadu_si128((const __m128i*)(pu64Mem + 6)), VWORD(xE3)))); \
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(xDiff, xZero)) != 0xFFFF)	\
+    {									\
+      break;								\
+    }									\
+    xE0 = _mm_add_epi64(xE0, xStep);					\
+    xE1 = _mm_add_epi64(xE1, xStep);					\
+    xE2 = _mm_add_epi64(xE2, xStep);					\
+    xE3 = _mm_add_epi64(xE3, xStep);					\
+    pu64Mem += 8;							\
+    u64StartValue += 8 * u64Step;					\
+    u64Words -= 8;							\
+    u64Done += 8;							\
+  }									\
+  ADT_VERIFY_TAIL(u64Done, SCALAR);
+
+#define ADT_VERIFY_AVX2_BODY(VWORD, SCALAR)				\
+  const uint64_t* pu64Mem = (const uint64_t*)pBufMem;			\
+  uint64_t u64Done = 0;							\
+  __m256i xE0, xE1, xE2, xE3, xStep, xSeed, xDiff;			\
+  xStep = _mm256_set1_epi64x(16 * u64Step);				\
+  xSeed = _mm256_set1_epi64x(u64Seed);					\
+  xE0 = _mm256_set_epi64x(u64StartValue + (3 * u64Step), u64StartValue + (2 * u64Step), \
+			  u64StartValue + u64Step, u64StartValue);	\
+  xE1 = _mm256_add_epi64(xE0, _mm256_set1_epi64x(4 * u64Step));	\
+  xE2 = _mm256_add_epi64(xE0, _mm256_set1_epi64x(8 * u64Step));	\
+  xE3 = _mm256_add_epi64(xE0, _mm256_set1_epi64x(12 * u64Step));	\
+  while (u64Words >= 16)						\
+  {									\
+    xDiff = _mm256_or_si256(						\
+      _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(pu64Mem + 0)), VWORD(xE0)), \
+		      _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(pu64Mem + 4)), VWORD(xE1))), \
+      _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(pu64Mem + 8)), VWORD(xE2)), \
+		      _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(pu64Mem + 12)), VWORD(xE3)))); \
+    if (!_mm256_testz_si256(xDiff, xDiff))				\
+    {									\
+      break;								\
+    }									\
+    xE0 = _mm256_add_epi64(xE0, xStep);					\
+    xE1 = _mm256_add_epi64(xE1, xStep);					\
+    xE2 = _mm256_add_epi64(xE2, xStep);					\
+    xE3 = _mm256_add_epi64(xE3, xStep);					\
+    pu64Mem += 16;							\
+    u64StartValue += 16 * u64Step;					\
+    u64Words -= 16;							\
+    u64Done += 16;							\
+  }									\
+  ADT_VERIFY_TAIL(u64Done, SCALAR);
+
+#define ADT_VERIFY_AVX512_BODY(VWORD, SCALAR)				\
+  const uint64_t* pu64Mem = (const uint64_t*)pBufMem;			\
+  uint64_t u64Done = 0;							\
+  __m512i xE0, xE1, xE2, xE3, xStep, xSeed, xDiff;			\
+  xStep = _mm512_set1_epi64(32 * u64Step);				\
+  xSeed = _mm512_set1_epi64(u64Seed);					\
+  xE0 = _mm512_add_epi64(_mm512_set1_epi64(u64StartValue),		\
+			 _mm512_set_epi64(7 * u64Step, 6 * u64Step, 5 * u64Step, 4 * u64Step, \
+					  3 * u64Step, 2 * u64Step, u64Step, 0)); \
+  xE1 = _mm512_add_epi64(xE0, _mm512_set1_epi64(8 * u64Step));		\
+  xE2 = _mm512_add_epi64(xE0, _mm512_set1_epi64(16 * u64Step));	\
+  xE3 = _mm512_add_epi64(xE0, _mm512_set1_epi64(24 * u64Step));	\
+  while (u64Words >= 32)						\
+  {									\
+    xDiff = _mm512_or_si512(						\
+      _mm512_or_si512(_mm512_xor_si512(_mm512_loadu_si512(pu64Mem + 0), VWORD(xE0)), \
+		      _mm512_xor_si512(_mm512_loadu_si512(pu64Mem + 8), VWORD(xE1))), \
+      _mm512_or_si512(_mm512_xor_si512(_mm512_loadu_si512(pu64Mem + 16), VWORD(xE2)), \
+		      _mm512_xor_si512(_mm512_loadu_si512(pu64Mem + 24), VWORD(xE3)))); \
+    if (_mm512_test_epi64_mask(xDiff, xDiff) != 0)			\
+    {									\
+      break;								\
+    }									\
+    xE0 = _mm512_add_epi64(xE0, xStep);					\
+    xE1 = _mm512_add_epi64(xE1, xStep);					\
+    xE2 = _mm512_add_epi64(xE2, xStep);					\
+    xE3 = _mm512_add_epi64(xE3, xStep);					\
+    pu64Mem += 32;							\
+    u64StartValue += 32 * u64Step;					\
+    u64Words -= 32;							\
+    u64Done += 32;							\
+  }									\
+  ADT_VERIFY_TAIL(u64Done, SCALAR);
+
+
+
+__attribute__((target("sse2")))
+static uint64_t u64ADT_VerifySse2(const void* pBufMem, uint64_t u64Words,
+				  uint64_t u64StartValue, uint64_t u64Step,
+				  uint64_t u64Seed)
+{
+  ADT_VERIFY_SSE2_BODY(ADT_SSE2_PLAIN, u64ADT_VerifyScalar);
+}
+
+__attribute__((target("sse2")))
+static uint64_t u64ADT_VerifyRandomSse2(const void* pBufMem, uint64_t u64Words,
+					uint64_t u64StartValue, uint64_t u64Step,
+					uint64_t u64Seed)
+{
+  ADT_PHILOX_KEYS(__m128i, _mm_set1_epi64x);
+  ADT_VERIFY_SSE2_BODY(ADT_SSE2_RANDOM, u64ADT_VerifyRandomScalar);
+}
+
+__attribute__((target("avx2")))
+static uint64_t u64ADT_VerifyAvx2(const void* pBufMem, uint64_t u64Words,
+				  uint64_t u64StartValue, uint64_t u64Step,
+				  uint64_t u64Seed)
+{
+  ADT_VERIFY_AVX2_BODY(ADT_AVX2_PLAIN, u64ADT_VerifyScalar);
+}
+
+__attribute__((target("avx2")))
+static uint64_t u64ADT_VerifyRandomAvx2(const void* pBufMem, uint64_t u64Words,
+					uint64_t u64StartValue, uint64_t u64Step,
+					uint64_t u64Seed)
+{
+  ADT_PHILOX_KEYS(__m256i, _mm256_set1_epi64x);
+  ADT_VERIFY_AVX2_BODY(ADT_AVX2_RANDOM, u64ADT_VerifyRandomScalar);
+}
+
+__attribute__((target("avx512f")))
+static uint64_t u64ADT_VerifyAvx512(const void* pBufMem, uint64_t u64Words,
+				    uint64_t u64StartValue, uint64_t u64Step,
+				    uint64_t u64Seed)
+{
+  ADT_VERIFY_AVX512_BODY(ADT_AVX512_PLAIN, u64ADT_VerifyScalar);
+}
+
+__attribute__((target("avx512f")))
+static uint64_t u64ADT_VerifyRandomAvx512(const void* pBufMem, uint64_t u64Words,
+					  uint64_t u64StartValue, uint64_t u64Step,
+					  uint64_t u64Seed)
+{
+  ADT_PHILOX_KEYS(__m512i, _mm512_set1_epi64);
+  ADT_VERIFY_AVX512_BODY(ADT_AVX512_RANDOM, u64ADT_VerifyRandomScalar);
+}
+
+
+
+static uint8_t bADT_HasSse2(void)
+{
+  return (__builtin_cpu_supports("sse2") ? 1 : 0);
+}
+
+static uint8_t bADT_HasAvx2(void)
+{
+  return (__builtin_cpu_supports("avx2") ? 1 : 0);
+}
+
+static uint8_t bADT_HasAvx512(void)
+{
+  return (__builtin_cpu_supports("avx512f") ? 1 : 0);
+}
+
+#endif // #ifdef ADT_PATTERN_X86
+
+
+
+#ifdef ADT_PATTERN_NEON
+
+static inline uint64x2_t xADT_PhiloxNeon(uint64x2_t xV, uint64x2_t xSeed, const uint64x2_t* pxKeys)
+{
+  uint32x2_t xMul = vdup_n_u32((uint32_t)ADT_PHILOX_MULTIPLIER);
+  uint64x2_t xProduct;
+  uint32_t i;
+
+  xV = veorq_u64(xV, xSeed);
+
+  for (i = 0; i < ADT_PHILOX_ROUNDS; i++)
+  {
+    xProduct = vmull_u32(vmovn_u64(xV), xMul);
+    xV = veorq_u64(veorq_u64(vreinterpretq_u64_u32(vrev64q_u32(vreinterpretq_u32_u64(xProduct))),
+			     vshrq_n_u64(xV, 32)), pxKeys[i]);
+  }
+
+  return xV;
+}
+
+#define ADT_NEON_PLAIN(V) veorq_u64((V), xSeed)
+#define ADT_NEON_RANDOM(V) xADT_PhiloxNeon((V), xSeed, axKeys)
+
+#define ADT_NEON_KEYS()							\
+  uint64x2_t axKeys[ADT_PHILOX_ROUNDS];					\
+  uint32_t u32Round;							\
+  for (u32Round = 0; u32Round < ADT_PHILOX_ROUNDS; u32Round++)		\
+  {									\
+    axKeys[u32Round] = vdupq_n_u64((uint64_t)u32ADT_PhiloxKey(u64Seed, u32Round)); \
+  }
+
+// No non-temporal stores to speak of, plain stores for both
+#define ADT_FILL_NEON_BODY(WORD, VWORD)					\
+  uint64_t* pu64Mem = (uint64_t*)pBufMem;				\
+  uint64_t au64Init[2] = { u64StartValue, u64StartValue + u64Step };	\
+  uint64x2_t xV0, xV1, xV2, xV3, xStep, xSeed;				\
+  xStep = vdupq_n_u64(8 * u64Step);					\
+  xSeed = vdupq_n_u64(u64Seed);						\
+  xV0 = vld1q_u64(au64Init);						\
+  xV1 = vaddq_u64(xV0, vdupq_n_u64(2 * u64Step));			\
+  xV2 = vaddq_u64(xV0, vdupq_n_u64(4 * u64Step));			\
+  xV3 = vaddq_u64(xV0, vdupq_n_u64(6 * u64Step));			\
+  while (u64Words >= 8)							\
+  {									\
+    vst1q_u64(pu64Mem + 0, VWORD(xV0));					\
+    vst1q_u64(pu64Mem + 2, VWORD(xV1));					\
+    vst1q_u64(pu64Mem + 4, VWORD(xV2));					\
+    vst1q_u64(pu64Mem + 6, VWORD(xV3));					\
+    xV0 = vaddq_u64(xV0, xStep);					\
+    xV1 = vaddq_u64(xV1, xStep);					\
+    xV2 = vaddq_u64(xV2, xStep);					\
+    xV3 = vaddq_u64(xV3, xStep);					\
+    pu64Mem += 8;							\
+    u64StartValue += 8 * u64Step;					\
+    u64Words -= 8;							\
+  }									\
+  while (u64Words > 0)							\
+  {									\
+    *(pu64Mem++) = WORD(u64StartValue);					\
+    u64StartValue += u64Step;						\
+    u64Words--;								\
+  }
+
+#define ADT_VERIFY_NEON_BODY(VWORD, SCALAR)				\
+  const uint64_t* pu64Mem = (const uint64_t*)pBufMem;			\
+  uint64_t u64Done = 0;							\
+  uint64_t au64Init[2] = { u64StartValue, u64StartValue + u64Step };	\
+  uint64x2_t xE0, xE1, xE2, xE3, xStep, xSeed, xDiff;			\
+  xStep = vdupq_n_u64(8 * u64Step);					\
+  xSeed = vdupq_n_u64(u64Seed);						\
+  xE0 = vld1q_u64(au64Init);						\
+  xE1 = vaddq_u64(xE0, vdupq_n_u64(2 * u64Step));			\
+  xE2 = vaddq_u64(xE0, vdupq_n_u64(4 * u64Step));			\
+  xE3 = vaddq_u64(xE0, vdupq_n_u64(6 * u64Step));			\
+  while (u64Words >= 8)							\
+  {									\
+    xDiff = vorrq_u64(vorrq_u64(veorq_u64(vld1q_u64(pu64Mem + 0), VWORD(xE0)), \
+				veorq_u64(vld1q_u64(pu64Mem + 2), VWORD(xE1))), \
+		      vorrq_u64(veorq_u64(vld1q_u64(pu64Mem + 4), VWORD(xE2)), \
+				veorq_u64(vld1q_u64(pu64Mem + 6), VWORD(xE3)))); \
+    if ((vgetq_lane_u64(xDiff, 0) | vgetq_lane_u64(xDiff, 1)) != 0)	\
+    {									\
+      break;								\
+    }									\
+    xE0 = vaddq_u64(xE0, xStep);					\
+    xE1 = vaddq_u64(xE1, xStep);					\
+    xE2 = vaddq_u64(xE2, xStep);					\
+    xE3 = vaddq_u64(xE3, xStep);					\
+    pu64Mem += 8;							\
+    u64StartValue += 8 * u64Step;					\
+    u64Words -= 8;							\
+    u64Done += 8;							\
+  }									\
+  return (u64Done + SCALAR(pu64Mem, u64Words, u64StartValue,		\
+			   u64Step, u64Seed));
+
+
+
+static void ADT_FillNeon(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+			 uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_FILL_NEON_BODY(ADT_WORD_PLAIN, ADT_NEON_PLAIN);
+}
+
+static void ADT_FillRandomNeon(void* pBufMem, uint64_t u64Words, uint64_t u64StartValue,
+			       uint64_t u64Step, uint64_t u64Seed)
+{
+  ADT_NEON_KEYS();
+  ADT_FILL_NEON_BODY(ADT_WORD_RANDOM, ADT_NEON_RANDOM);
+}
+
+
+
+static uint64_t u64ADT_VerifyNeon(const void* pBufMem, uint64_t u64Words,
+				  uint64_t u64StartValue, uint64_t u64Step,
+				  uint64_t u64Seed)
+{
+  ADT_VERIFY_NEON_BODY(ADT_NEON_PLAIN, u64ADT_VerifyScalar);
+}
+
+static uint64_t u64ADT_VerifyRandomNeon(const void* pBufMem, uint64_t u64Words,
+					uint64_t u64StartValue, uint64_t u64Step,
+					uint64_t u64Seed)
+{
+  ADT_NEON_KEYS();
+  ADT_VERIFY_NEON_BODY(ADT_NEON_RANDOM, u64ADT_VerifyRandomScalar);
+}
+
+
+
+static uint8_t bADT_HasNeon(void)
+{
+  return ((getauxval(AT_HWCAP) & HWCAP_ASIMD) ? 1 : 0);
+}
+
+#endif // #ifdef ADT_PATTERN_NEON
+
+
+
+// CRC32C (Castagnoli), by the CPU's crc32 instructions when there
+// are some. Raw functions go without the usual inversions.
+#define ADT_CRC32C_POLY ((uint32_t)0x82F63B78)
+
+typedef uint32_t (*tAdtCrcFunc)(uint32_t u32Crc, const uint8_t* pu8Mem, uint64_t u64Bytes);
+
+static uint32_t au32Crc32cTable[256];
+
+static uint32_t u32ADT_Crc32cScalar(uint32_t u32Crc, const uint8_t* pu8Mem, uint64_t u64Bytes)
+{
+  while (u64Bytes > 0)
+  {
+    u32Crc = au32Crc32cTable[(u32Crc ^ *(pu8Mem++)) & 0xFF] ^ (u32Crc >> 8);
+    u64Bytes--;
+  }
+
+  return u32Crc;
+}
+
+#ifdef ADT_PATTERN_X86
+
+__attribute__((target("sse4.2")))
+static uint32_t u32ADT_Crc32cSse42(uint32_t u32Crc, const uint8_t* pu8Mem, uint64_t u64Bytes)
+{
+  uint64_t u64Crc = u32Crc;
+  uint64_t u64Word = 0;
+
+  while (u64Bytes >= 8)
+  {
+    memcpy(&u64Word, pu8Mem, sizeof(u64Word));
+    u64Crc = _mm_crc32_u64(u64Crc, u64Word);
+    pu8Mem += 8;
+    u64Bytes -= 8;
+  }
+  u32Crc = (uint32_t)u64Crc;
+
+  while (u64Bytes > 0)
+  {
+    u32Crc = _mm_crc32_u8(u32Crc, *(pu8Mem++));
+    u64Bytes--;
+  }
+
+  return u32Crc;
+}
+
+#endif // #ifdef ADT_PATTERN_X86
+
+#ifdef ADT_PATTERN_NEON
+
+__attribute__((target("+crc")))
+static uint32_t u32ADT_Crc32cArm(uint32_t u32Crc, const uint8_t* pu8Mem, uint64_t u64Bytes)
+{
+  uint64_t u64Word = 0;
+
+  while (u64Bytes >= 8)
+  {
+    memcpy(&u64Word, pu8Mem, sizeof(u64Word));
+    u32Crc = __crc32cd(u32Crc, u64Word);
+    pu8Mem += 8;
+    u64Bytes -= 8;
+  }
+  while (u64Bytes > 0)
+  {
+    u32Crc = __crc32cb(u32Crc, *(pu8Mem++));
+    u64Bytes--;
+  }
+
+  return u32Crc;
+}
+
+#endif // #ifdef ADT_PATTERN_NEON
+
+static tAdtCrcFunc pfSelectedCrc = u32ADT_Crc32cScalar;
+
+static void ADT_CrcInit(void)
+{
+  uint32_t u32Crc = 0;
+  uint32_t i;
+  uint32_t j;
+
+  for (i = 0; i < 256; i++)
+  {
+    u32Crc = i;
+
+    for (j = 0; j < 8; j++)
+    {
+      u32Crc = ((u32Crc & 1) ? ((u32Crc >> 1) ^ ADT_CRC32C_POLY) : (u32Crc >> 1));
+    }
+    au32Crc32cTable[i] = u32Crc;
+  }
+#ifdef ADT_PATTERN_X86
+  if (__builtin_cpu_supports("sse4.2"))
+  {
+    pfSelectedCrc = u32ADT_Crc32cSse42;
+  }
+#endif
+#ifdef ADT_PATTERN_NEON
+  if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+  {
+    pfSelectedCrc = u32ADT_Crc32cArm;
+  }
+#endif
+}
+
+
+
+// Best last, selection goes from the end
+static const tAdtPatternKernel axKernels[] =
+{
+  { "scalar", bADT_AlwaysSupported, ADT_FillScalar, ADT_FillScalar,
+    u64ADT_VerifyScalar, ADT_FillRandomScalar, ADT_FillRandomScalar,
+    u64ADT_VerifyRandomScalar },
+#ifdef ADT_PATTERN_X86
+  { "sse2", bADT_HasSse2, ADT_FillSse2, ADT_FillSse2Nt,
+    u64ADT_VerifySse2, ADT_FillRandomSse2, ADT_FillRandomSse2Nt,
+    u64ADT_VerifyRandomSse2 },
+  { "avx2", bADT_HasAvx2, ADT_FillAvx2, ADT_FillAvx2Nt,
+    u64ADT_VerifyAvx2, ADT_FillRandomAvx2, ADT_FillRandomAvx2Nt,
+    u64ADT_VerifyRandomAvx2 },
+  { "avx512", bADT_HasAvx512, ADT_FillAvx512, ADT_FillAvx512Nt,
+    u64ADT_VerifyAvx512, ADT_FillRandomAvx512, ADT_FillRandomAvx512Nt,
+    u64ADT_VerifyRandomAvx512 },
+#endif
+#ifdef ADT_PATTERN_NEON
+  { "neon", bADT_HasNeon, ADT_FillNeon, ADT_FillNeon,
+    u64ADT_VerifyNeon, ADT_FillRandomNeon, ADT_FillRandomNeon,
+    u64ADT_VerifyRandomNeon },
+#endif
+};
+
+static const tAdtPatternKernel* pxSelectedKernel = &(axKernels[0]);
+static tAdtFillFunc pfSelectedFill = ADT_FillScalar;
+static tAdtVerifyFunc pfSelectedVerify = u64ADT_VerifyScalar;
+
+
+
+// Function pointers follow the kernel, store type and pattern family
+static void ADT_PatternPickFuncs(void)
+{
+  if (u8PatternRandom)
+  {
+    pfSelectedFill = (u8PatternNonTemporal ?
+		      pxSelectedKernel->pfFillRandomNonTemporal : pxSelectedKernel->pfFillRandom);
+    pfSelectedVerify = pxSelectedKernel->pfVerifyRandom;
+  }
+  else
+  {
+    pfSelectedFill = (u8PatternNonTemporal ?
+		      pxSelectedKernel->pfFillNonTemporal : pxSelectedKernel->pfFill);
+    pfSelectedVerify = pxSelectedKernel->pfVerify;
+  }
+}
+
+
+
+uint32_t u32ADT_PatternKernelCount(void)
+{
+  return (sizeof(axKernels) / sizeof(axKernels[0]));
+}
+
+
+
+const tAdtPatternKernel* pxADT_PatternKernel(uint32_t u32Index)
+{
+  if (u32Index >= u32ADT_PatternKernelCount())
+  {
+    return NULL;
+  }
+
+  return &(axKernels[u32Index]);
+}
+
+
+
+// Picks the best kernel the CPU can run. Call before any threads.
+void ADT_PatternInit(uint8_t u8NonTemporal)
+{
+  uint32_t i = u32ADT_PatternKernelCount();
+
+  ADT_CrcInit();
+
+  while (i > 0)
+  {
+    i--;
+
+    if (axKernels[i].bSupported())
+    {
+      pxSelectedKernel = &(axKernels[i]);
+      u8PatternNonTemporal = u8NonTemporal;
+      ADT_PatternPickFuncs();
+
+      return;
+    }
+  }
+}
+
+
+
+uint8_t bADT_PatternSelectKernel(const char* sName, uint8_t u8NonTemporal)
+{
+  uint32_t i;
+
+  for (i = 0; i < u32ADT_PatternKernelCount(); i++)
+  {
+    if ((strcmp(axKernels[i].sName, sName) == 0) && axKernels[i].bSupported())
+    {
+      pxSelectedKernel = &(axKernels[i]);
+      u8PatternNonTemporal = u8NonTemporal;
+      ADT_PatternPickFuncs();
+
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+
+const char* sADT_PatternKernelName(void)
+{
+  return pxSelectedKernel->sName;
+}
+
+
+
+// Words are running numbers by default, or with u8OffsetKeyed the
+// byte offset of the word itself. Either way xored with the seed,
+// and with u8Random then scrambled with Philox keyed by the seed.
+void ADT_PatternSetKey(uint8_t u8OffsetKeyed, uint8_t u8Random, uint64_t u64Seed)
+{
+  u64PatternStep = (u8OffsetKeyed ? ADT_PATTERN_WORD_SIZE : 1);
+  u64PatternSeed = u64Seed;
+  u8PatternRandom = (u8Random ? 1 : 0);
+  ADT_PatternPickFuncs();
+}
+
+
+
+// Value of the word at running number u64Number
+uint64_t u64ADT_PatternWord(uint64_t u64Number)
+{
+  if (u8PatternRandom)
+  {
+    return u64ADT_Philox(u64Number * u64PatternStep, u64PatternSeed);
+  }
+
+  return ((u64Number * u64PatternStep) ^ u64PatternSeed);
+}
+
+
+
+// Sector mode, see tAdtSectorHeader. Run id and pass are for
+// telling old data from new, the pattern key stays as it is.
+void ADT_PatternSetSectors(uint8_t u8Sectors, uint64_t u64RunId, uint32_t u32Pass)
+{
+  u8PatternSectors = (u8Sectors ? 1 : 0);
+  u64PatternRunId = u64RunId;
+  u32PatternPass = u32Pass;
+}
+
+
+
+uint32_t u32ADT_PatternCrc32c(const void* pMem, uint64_t u64Bytes)
+{
+  return ~(pfSelectedCrc(0xFFFFFFFF, (const uint8_t*)pMem, u64Bytes));
+}
+
+
+
+static uint32_t u32ADT_SectorCrc(const void* pSector)
+{
+  return u32ADT_PatternCrc32c(pSector + offsetof(tAdtSectorHeader, u64Lba),
+			      ADT_PATTERN_SECTOR_SIZE - offsetof(tAdtSectorHeader, u64Lba));
+}
+
+
+
+// Header of any sector, returns 1 only if it is one of ours and intact
+uint8_t bADT_PatternSectorInfo(const void* pSector, tAdtSectorHeader* pxHeader)
+{
+  memcpy(pxHeader, pSector, sizeof(*pxHeader));
+
+  return ((pxHeader->u32Magic == ADT_PATTERN_SECTOR_MAGIC) &&
+	  (pxHeader->u32Crc == u32ADT_SectorCrc(pSector)));
+}
+
+
+
+// Pattern is already there, just the header on top
+static void ADT_SectorStamp(void* pSector, uint64_t u64Lba)
+{
+  tAdtSectorHeader* pxHeader = (tAdtSectorHeader*)pSector;
+
+  pxHeader->u32Magic = ADT_PATTERN_SECTOR_MAGIC;
+  pxHeader->u64Lba = u64Lba;
+  pxHeader->u64RunId = u64PatternRunId;
+  pxHeader->u32Pass = u32PatternPass;
+  pxHeader->u32Reserved = 0;
+  pxHeader->u32Crc = u32ADT_SectorCrc(pSector);
+}
+
+
+
+static void ADT_SectorBuild(void* pSector, uint64_t u64Lba)
+{
+  pfSelectedFill(pSector, ADT_PATTERN_SECTOR_SIZE / ADT_PATTERN_WORD_SIZE,
+		 u64Lba * (ADT_PATTERN_SECTOR_SIZE / ADT_PATTERN_WORD_SIZE) * u64PatternStep,
+		 u64PatternStep, u64PatternSeed);
+  ADT_SectorStamp(pSector, u64Lba);
+}
+
+
+
+// Whole sectors get their headers in place, partial ones at the
+// edges are built aside and the covered part copied.
+static void ADT_SectorsFill(void* pBufMem, uint64_t u64Bytes, uint64_t u64Pos)
+{
+  uint8_t au8Sector[ADT_PATTERN_SECTOR_SIZE] __attribute__((aligned(64)));
+  uint64_t u64Done = 0;
+  uint64_t u64In = 0;
+  uint64_t u64Chunk = 0;
+
+  while (u64Done < u64Bytes)
+  {
+    u64In = (u64Pos + u64Done) % ADT_PATTERN_SECTOR_SIZE;
+    u64Chunk = ADT_PATTERN_SECTOR_SIZE - u64In;
+    u64Chunk = ((u64Chunk > (u64Bytes - u64Done)) ? (u64Bytes - u64Done) : u64Chunk);
+
+    if (u64Chunk == ADT_PATTERN_SECTOR_SIZE)
+    {
+      ADT_SectorStamp(pBufMem + u64Done, (u64Pos + u64Done) / ADT_PATTERN_SECTOR_SIZE);
+    }
+    else
+    {
+      ADT_SectorBuild(au8Sector, (u64Pos + u64Done) / ADT_PATTERN_SECTOR_SIZE);
+      memcpy(pBufMem + u64Done, au8Sector + u64In, u64Chunk);
+    }
+    u64Done += u64Chunk;
+  }
+}
+
+
+
+// Odd tail bytes after the last full word are zeroed
+void ADT_PatternFill(void* pBufMem, uint64_t u64Bytes, uint64_t u64StartNumber)
+{
+  uint64_t u64Words = u64Bytes / ADT_PATTERN_WORD_SIZE;
+
+  pfSelectedFill(pBufMem, u64Words, u64StartNumber * u64PatternStep,
+		 u64PatternStep, u64PatternSeed);
+  memset(pBufMem + (u64Words * ADT_PATTERN_WORD_SIZE), 0,
+	 u64Bytes - (u64Words * ADT_PATTERN_WORD_SIZE));
+
+  if (u8PatternSectors)
+  {
+    ADT_SectorsFill(pBufMem, u64Bytes, u64StartNumber * ADT_PATTERN_WORD_SIZE);
+  }
+}
+
+
+
+// Offset of the first differing byte, u64Bytes if none
+static uint64_t u64ADT_FirstDiff(const uint8_t* pu8A, const uint8_t* pu8B, uint64_t u64Bytes)
+{
+  uint64_t i;
+
+  for (i = 0; i < u64Bytes; i++)
+  {
+    if (pu8A[i] != pu8B[i])
+    {
+      break;
+    }
+  }
+
+  return i;
+}
+
+
+
+// Whole sectors are checked by their header and CRC alone, so they
+// pass even if written with other pattern settings. Only what fails
+// is rebuilt, to find the exact byte. Partial sectors at the edges
+// can only be compared against a rebuilt one.
+static uint64_t u64ADT_SectorsVerify(const void* pBufMem, uint64_t u64Bytes, uint64_t u64Pos,
+				     uint64_t* pu64Expected, uint64_t* pu64Actual,
+				     uint8_t* pu8Kind)
+{
+  uint8_t au8Sector[ADT_PATTERN_SECTOR_SIZE] __attribute__((aligned(64)));
+  const uint8_t* pu8Mem = (const uint8_t*)pBufMem;
+  tAdtSectorHeader xHeader;
+  uint64_t u64Lba = 0;
+  uint64_t u64Done = 0;
+  uint64_t u64In = 0;
+  uint64_t u64Chunk = 0;
+  uint64_t u64Bad = 0;
+  uint64_t u64WordBytes = 0;
+  uint8_t u8Valid = 0;
+
+  while (u64Done < u64Bytes)
+  {
+    u64Lba = (u64Pos + u64Done) / ADT_PATTERN_SECTOR_SIZE;
+    u64In = (u64Pos + u64Done) % ADT_PATTERN_SECTOR_SIZE;
+    u64Chunk = ADT_PATTERN_SECTOR_SIZE - u64In;
+    u64Chunk = ((u64Chunk > (u64Bytes - u64Done)) ? (u64Bytes - u64Done) : u64Chunk);
+    *pu8Kind = ADT_PATTERN_BAD_DATA;
+
+    if (u64Chunk == ADT_PATTERN_SECTOR_SIZE)
+    {
+      u8Valid = bADT_PatternSectorInfo(pu8Mem + u64Done, &xHeader);
+
+      if (u8Valid && (xHeader.u64Lba == u64Lba) && (xHeader.u64RunId == u64PatternRunId) &&
+	  (xHeader.u32Pass == u32PatternPass))
+      {
+	u64Done += u64Chunk;
+
+	continue;
+      }
+      if (xHeader.u32Magic == ADT_PATTERN_SECTOR_MAGIC)
+      {
+	// Ours at least once. Rotten, somebody else's, or old.
+	*pu8Kind = ((!u8Valid) ? ADT_PATTERN_BAD_CRC :
+		    ((xHeader.u64Lba != u64Lba) ? ADT_PATTERN_BAD_LBA : ADT_PATTERN_BAD_STALE));
+      }
+    }
+    ADT_SectorBuild(au8Sector, u64Lba);
+    u64Bad = u64ADT_FirstDiff(au8Sector + u64In, pu8Mem + u64Done, u64Chunk);
+
+    if ((u64Bad < u64Chunk) || (u64Chunk == ADT_PATTERN_SECTOR_SIZE))
+    {
+      // Whole words around the bad byte, sector start if none found
+      u64Bad = ((u64Bad < u64Chunk) ? u64Bad : 0) & ~(ADT_PATTERN_WORD_SIZE - 1);
+      u64WordBytes = (((u64Chunk - u64Bad) > ADT_PATTERN_WORD_SIZE) ?
+		      ADT_PATTERN_WORD_SIZE : (u64Chunk - u64Bad));
+      memcpy(pu64Expected, au8Sector + u64In + u64Bad, u64WordBytes);
+      memcpy(pu64Actual, pu8Mem + u64Done + u64Bad, u64WordBytes);
+      u64Bad += ((*pu64Expected != *pu64Actual) ?
+		 (__builtin_ctzll(*pu64Expected ^ *pu64Actual) / 8) : 0);
+
+      return (u64Done + u64Bad);
+    }
+    u64Done += u64Chunk;
+  }
+
+  return u64Bytes;
+}
+
+
+
+// Checks the buffer in place. Returns the offset of the exact first
+// wrong byte, u64Bytes if everything is fine. Expected and actual
+// are then the whole words the byte is in.
+uint64_t u64ADT_PatternVerify(const void* pBufMem, uint64_t u64Bytes,
+			      uint64_t u64StartNumber,
+			      uint64_t* pu64Expected, uint64_t* pu64Actual,
+			      uint8_t* pu8Kind)
+{
+  uint64_t u64Words = u64Bytes / ADT_PATTERN_WORD_SIZE;
+  uint64_t u64TailBytes = u64Bytes - (u64Words * ADT_PATTERN_WORD_SIZE);
+  uint64_t u64BadWord = 0;
+  uint64_t u64Diff = 0;
+
+  *pu64Expected = 0;
+  *pu64Actual = 0;
+  *pu8Kind = ADT_PATTERN_BAD_DATA;
+
+  if (u8PatternSectors)
+  {
+    return u64ADT_SectorsVerify(pBufMem, u64Bytes, u64StartNumber * ADT_PATTERN_WORD_SIZE,
+				pu64Expected, pu64Actual, pu8Kind);
+  }
+  u64BadWord = pfSelectedVerify(pBufMem, u64Words, u64StartNumber * u64PatternStep,
+				u64PatternStep, u64PatternSeed);
+
+  if (u64BadWord < u64Words)
+  {
+    *pu64Expected = u64ADT_PatternWord(u64StartNumber + u64BadWord);
+    memcpy(pu64Actual, pBufMem + (u64BadWord * ADT_PATTERN_WORD_SIZE),
+	   ADT_PATTERN_WORD_SIZE);
+  }
+  else if (u64TailBytes)
+  {
+    // Odd tail after the last word is supposed to be zeros
+    memcpy(pu64Actual, pBufMem + (u64Words * ADT_PATTERN_WORD_SIZE), u64TailBytes);
+  }
+  u64Diff = *pu64Expected ^ *pu64Actual;
+
+  if (u64Diff == 0)
+  {
+    return u64Bytes;
+  }
+
+  // Words are in memory little-endian
+  return ((u64BadWord * ADT_PATTERN_WORD_SIZE) + (__builtin_ctzll(u64Diff) / 8));
+}
@@ -0,0 +1,77 @@
+#ifndef _ADT_PATTERN_H_
+#define _ADT_PATTERN_H_
+
+#include <inttypes.h>
+
+#define ADT_PATTERN_WORD_SIZE ((uint64_t)8)
+#define ADT_PATTERN_SECTOR_SIZE ((uint64_t)4096)
+#define ADT_PATTERN_SECTOR_MAGIC ((uint32_t)0x31534344) // "DCS1"
+
+// What was wrong with the first bad byte found
+#define ADT_PATTERN_BAD_DATA ((uint8_t)(0))
+#define ADT_PATTERN_BAD_CRC ((uint8_t)(1))
+#define ADT_PATTERN_BAD_LBA ((uint8_t)(2))
+#define ADT_PATTERN_BAD_STALE ((uint8_t)(3))
+
+
+// In sector mode every 4 KiB sector starts with this, rest is the
+// normal pattern. CRC32C covers everything after the CRC itself.
+// LBA is in sectors, so the byte offset divided by 4096.
+typedef struct
+{
+  uint32_t u32Magic;
+  uint32_t u32Crc;
+  uint64_t u64Lba;
+  uint64_t u64RunId;
+  uint32_t u32Pass;
+  uint32_t u32Reserved;
+
+} tAdtSectorHeader;
+
+
+// Fills u64Words words, word i being (u64StartValue + i * u64Step) ^ u64Seed,
+// for the random family that run through Philox keyed by u64Seed.
+typedef void (*tAdtFillFunc)(void* pBufMem, uint64_t u64Words,
+			     uint64_t u64StartValue, uint64_t u64Step,
+			     uint64_t u64Seed);
+
+// Returns index of the first word not matching what the fill with
+// the same arguments would write, u64Words if all match.
+typedef uint64_t (*tAdtVerifyFunc)(const void* pBufMem, uint64_t u64Words,
+				   uint64_t u64StartValue, uint64_t u64Step,
+				   uint64_t u64Seed);
+
+typedef struct
+{
+  const char* sName;
+  uint8_t (*bSupported)(void);
+  tAdtFillFunc pfFill;
+  tAdtFillFunc pfFillNonTemporal;
+  tAdtVerifyFunc pfVerify;
+  tAdtFillFunc pfFillRandom;
+  tAdtFillFunc pfFillRandomNonTemporal;
+  tAdtVerifyFunc pfVerifyRandom;
+
+} tAdtPatternKernel;
+
+
+void ADT_PatternInit(uint8_t u8NonTemporal);
+uint8_t bADT_PatternSelectKernel(const char* sName, uint8_t u8NonTemporal);
+const char* sADT_PatternKernelName(void);
+
+void ADT_PatternSetKey(uint8_t u8OffsetKeyed, uint8_t u8Random, uint64_t u64Seed);
+uint64_t u64ADT_PatternWord(uint64_t u64Number);
+void ADT_PatternSetSectors(uint8_t u8Sectors, uint64_t u64RunId, uint32_t u32Pass);
+uint8_t bADT_PatternSectorInfo(const void* pSector, tAdtSectorHeader* pxHeader);
+uint32_t u32ADT_PatternCrc32c(const void* pMem, uint64_t u64Bytes);
+
+uint32_t u32ADT_PatternKernelCount(void);
+const tAdtPatternKernel* pxADT_PatternKernel(uint32_t u32Index);
+
+void ADT_PatternFill(void* pBufMem, uint64_t u64Bytes, uint64_t u64StartNumber);
+uint64_t u64ADT_PatternVerify(const void* pBufMem, uint64_t u64Bytes,
+			      uint64_t u64StartNumber,
+			      uint64_t* pu64Expected, uint64_t* pu64Actual,
+			      uint8_t* pu8Kind);
+
+#endif // #define _ADT_PATTERN_H_
@@ -1,10 +1,28 @@
+#define _GNU_SOURCE // For fallocate
+
 #include "adt_shared.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
 #include <linux/hdreg.h>
 #include <linux/fs.h>
+#include <linux/mempolicy.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#define ADT_MEM_HUGE_2M_BYTES (((uint64_t)2) * ADT_BYTES_IN_MEBIBYTE)
+#define ADT_MEM_HUGE_1G_BYTES ((uint64_t)ADT_BYTES_IN_GIBIBYTE)
 
 
 void ADT_TrimBegin(char* sParamString)
@@ -74,6 +92,7 @@ uint8_t bADT_IdentifyDisk(int iFd, char* sModel,
 {
   uint8_t u8RetVal = 1;
   uint64_t u64Temp = 0;
+  struct stat xStat;
   uint16_t au16DriveInfoRaw[ADT_DISK_RAW_INFO_IOCTL_SIZE] = { 0 };
 
   if ((sModel != NULL) || (sSerial != NULL) || (sFirmware != NULL))
@@ -99,20 +118,24 @@ uint8_t bADT_IdentifyDisk(int iFd, char* sModel,
       // Got it, now put it to only non-null buffers
       if (sModel != NULL)
       {
-	strncpy(sModel, (char*)(&(au16DriveInfoRaw[ADT_DISK_INFO_MODEL_IOCTL_POS])),
-		ADT_DISK_INFO_MODEL_LEN);
+	// Fields are fixed width, not terminated
+	memcpy(sModel, &(au16DriveInfoRaw[ADT_DISK_INFO_MODEL_IOCTL_POS]),
+	       ADT_DISK_INFO_MODEL_LEN);
+	sModel[ADT_DISK_INFO_MODEL_LEN] = 0;
 	ADT_Trim(sModel);
       }
       if (sSerial != NULL)
       {
-	strncpy(sSerial, (char*)(&(au16DriveInfoRaw[ADT_DISK_INFO_SERIAL_IOCTL_POS])),
-		ADT_DISK_INFO_SERIAL_LEN);
+	memcpy(sSerial, &(au16DriveInfoRaw[ADT_DISK_INFO_SERIAL_IOCTL_POS]),
+	       ADT_DISK_INFO_SERIAL_LEN);
+	sSerial[ADT_DISK_INFO_SERIAL_LEN] = 0;
 	ADT_Trim(sSerial);
       }
       if (sFirmware != NULL)
       {
-	strncpy(sFirmware, (char*)(&(au16DriveInfoRaw[ADT_DISK_INFO_FIRMWARE_IOCTL_POS])),
-		ADT_DISK_INFO_FIRMWARE_LEN);
+	memcpy(sFirmware, &(au16DriveInfoRaw[ADT_DISK_INFO_FIRMWARE_IOCTL_POS]),
+	       ADT_DISK_INFO_FIRMWARE_LEN);
+	sFirmware[ADT_DISK_INFO_FIRMWARE_LEN] = 0;
 	ADT_Trim(sFirmware);
       }
       
@@ -134,15 +157,352 @@ uint8_t bADT_IdentifyDisk(int iFd, char* sModel,
 
       u8RetVal = ((u8RetVal > 0) ? 1 : u8RetVal);
     }
+    else if ((fstat(iFd, &xStat) == 0) && S_ISREG(xStat.st_mode))
+    {
+      // Regular file stands in for a disk
+      *pu64SizeBytes = xStat.st_size;
+    }
+    else
+    {
+      u8RetVal = 0;
+    }
+  }
+
+  return u8RetVal;
+}
+
+// Parses sizes like 4096, 64K, 1M or 2G, also 1024-based
+uint8_t bADT_ParseSize(const char* sSizeString, uint64_t* pu64SizeBytes)
+{
+  char* sEnd = NULL;
+  uint64_t u64Value = 0;
+
+  if ((sSizeString[0] < '0') || (sSizeString[0] > '9'))
+  {
+    return 0;
+  }
+  u64Value = strtoull(sSizeString, &sEnd, 10);
+
+  switch (*sEnd)
+  {
+  case 0:
+    break;
+  case 'k':
+  case 'K':
+    u64Value *= ADT_BYTES_IN_KIBIBYTE;
+    sEnd++;
+    break;
+  case 'm':
+  case 'M':
+    u64Value *= ADT_BYTES_IN_MEBIBYTE;
+    sEnd++;
+    break;
+  case 'g':
+  case 'G':
+    u64Value *= ADT_BYTES_IN_GIBIBYTE;
+    sEnd++;
+    break;
+  case 't':
+  case 'T':
+    u64Value *= ADT_BYTES_IN_TEBIBYTE;
+    sEnd++;
+    break;
+  default:
+    return 0;
+  }
+  if (*sEnd != 0)
+  {
+    // Trailing garbage
+    return 0;
+  }
+  *pu64SizeBytes = u64Value;
+
+  return 1;
+}
+
+// Parses plain decimal counts, no size suffixes
+uint8_t bADT_ParseCount(const char* sCountString, uint64_t* pu64Count)
+{
+  char* sEnd = NULL;
+  uint64_t u64Value = 0;
+
+  if ((sCountString[0] < '0') || (sCountString[0] > '9'))
+  {
+    return 0;
+  }
+  u64Value = strtoull(sCountString, &sEnd, 10);
+
+  if (*sEnd != 0)
+  {
+    return 0;
+  }
+  *pu64Count = u64Value;
+
+  return 1;
+}
+
+// Logical block size, the granularity needed by O_DIRECT.
+// For regular files the file system block is the safe bet.
+uint8_t bADT_GetBlockSize(int iFd, uint32_t* pu32BlockSize)
+{
+  int iTemp = 0;
+  struct stat xStat;
+
+  *pu32BlockSize = ADT_DEFAULT_BLOCK_SIZE;
+
+  if ((fstat(iFd, &xStat) == 0) && S_ISREG(xStat.st_mode) && (xStat.st_blksize > 0))
+  {
+    *pu32BlockSize = (uint32_t)xStat.st_blksize;
+
+    return 1;
+  }
+  if ((ioctl(iFd, BLKSSZGET, &iTemp) != 0) || (iTemp <= 0))
+  {
+    return 0;
+  }
+  *pu32BlockSize = (uint32_t)iTemp;
+
+  return 1;
+}
+
+// Creates or resizes a regular file to stand in for a disk. Space
+// is reserved with fallocate, file systems without it get a sparse
+// file. Returns 0 with errno set on failure.
+uint8_t bADT_PrepareFile(const char* sPath, uint64_t u64SizeBytes, uint8_t* pu8Sparse)
+{
+  struct stat xStat;
+  int iFd = open(sPath, O_RDWR | O_CREAT, 0644);
+  int iErrno = 0;
+  uint8_t u8RetVal = 1;
+
+  *pu8Sparse = 0;
+
+  if (iFd == -1)
+  {
+    return 0;
+  }
+  if ((fstat(iFd, &xStat) != 0) || (!S_ISREG(xStat.st_mode)))
+  {
+    // Would wipe a real disk behind the user's back
+    close(iFd);
+    errno = EINVAL;
+
+    return 0;
+  }
+  if (((uint64_t)xStat.st_size > u64SizeBytes) && (ftruncate(iFd, u64SizeBytes) != 0))
+  {
+    u8RetVal = 0;
+  }
+  else if (fallocate(iFd, 0, 0, u64SizeBytes) != 0)
+  {
+    if ((errno == EOPNOTSUPP) || (errno == ENOSYS))
+    {
+      *pu8Sparse = 1;
+      u8RetVal = (ftruncate(iFd, u64SizeBytes) == 0);
+    }
     else
     {
       u8RetVal = 0;
     }
   }
+  iErrno = errno;
+  close(iFd);
+  errno = iErrno;
 
   return u8RetVal;
 }
 
+static const char* asAdtWipeNames[] = { "zeroout", "discard", "secure", "write" };
+
+// Wipe way from the command line
+uint8_t bADT_ParseWipe(const char* sWipeString, uint8_t* pu8Wipe)
+{
+  uint8_t i;
+
+  for (i = 0; i < (sizeof(asAdtWipeNames) / sizeof(asAdtWipeNames[0])); i++)
+  {
+    if (strcmp(sWipeString, asAdtWipeNames[i]) == 0)
+    {
+      *pu8Wipe = i;
+
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+const char* sADT_WipeName(uint8_t u8Wipe)
+{
+  return asAdtWipeNames[u8Wipe];
+}
+
+// Zeros from a zeroed buffer, synced and out of the page cache
+// so that checking it reads the disk. Small scratch buffers are
+// plain heap, no point in huge pages or locking for them.
+static uint8_t bADT_WriteZeros(int iFd, uint64_t u64Offset, uint64_t u64Bytes)
+{
+  void* pMem = NULL;
+  uint64_t u64Pos = 0;
+  uint64_t u64Chunk = 0;
+  uint8_t u8RetVal = 1;
+
+  if (posix_memalign(&pMem, ADT_WIPE_CHECK_ALIGN, ADT_BYTES_IN_MEBIBYTE) != 0)
+  {
+    return 0;
+  }
+  memset(pMem, 0, ADT_BYTES_IN_MEBIBYTE);
+
+  for (u64Pos = 0; (u64Pos < u64Bytes) && u8RetVal; u64Pos += u64Chunk)
+  {
+    u64Chunk = (((u64Bytes - u64Pos) > ADT_BYTES_IN_MEBIBYTE) ?
+		ADT_BYTES_IN_MEBIBYTE : (u64Bytes - u64Pos));
+    u8RetVal = (pwrite(iFd, pMem, u64Chunk, u64Offset + u64Pos) == (ssize_t)u64Chunk);
+  }
+  free(pMem);
+
+  if ((!u8RetVal) || (fdatasync(iFd) != 0))
+  {
+    return 0;
+  }
+  posix_fadvise(iFd, u64Offset, u64Bytes, POSIX_FADV_DONTNEED);
+
+  return 1;
+}
+
+// Lets the device do the wipe if it can: BLKZEROOUT, BLKDISCARD or
+// BLKSECDISCARD on disks, zero range or hole punching on files. When
+// not supported falls back to writing zeros, *pu8Used tells which
+// one did it. Range must be whole logical blocks.
+uint8_t bADT_WipeRange(int iFd, uint64_t u64Offset, uint64_t u64Bytes,
+		       uint8_t u8Wipe, uint8_t* pu8Used)
+{
+  struct stat xStat;
+  uint64_t au64Range[2] = { u64Offset, u64Bytes };
+  unsigned long aulIoctls[] = { BLKZEROOUT, BLKDISCARD, BLKSECDISCARD };
+  int aiFallocModes[] = { FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE,
+			  FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, -1 };
+  int iRet = -1;
+
+  *pu8Used = u8Wipe;
+
+  if (u8Wipe != ADT_WIPE_WRITE)
+  {
+    if ((fstat(iFd, &xStat) == 0) && S_ISREG(xStat.st_mode))
+    {
+      errno = EOPNOTSUPP;
+      iRet = ((aiFallocModes[u8Wipe] == -1) ? -1 :
+	      fallocate(iFd, aiFallocModes[u8Wipe], u64Offset, u64Bytes));
+    }
+    else
+    {
+      iRet = ioctl(iFd, aulIoctls[u8Wipe], au64Range);
+    }
+    if (iRet == 0)
+    {
+      return 1;
+    }
+    if ((errno != EOPNOTSUPP) && (errno != ENOTTY) && (errno != EINVAL))
+    {
+      // Real error, writing would likely fail too
+      return 0;
+    }
+  }
+  *pu8Used = ADT_WIPE_WRITE;
+
+  return bADT_WriteZeros(iFd, u64Offset, u64Bytes);
+}
+
+// Reads the first and last pieces of the range and the rest evenly
+// in between, 1 if all are zeros. Otherwise gives the offset of the
+// first piece with something in it.
+uint8_t bADT_CheckZeroed(int iFd, uint64_t u64Offset, uint64_t u64Bytes,
+			 uint32_t u32Samples, uint64_t* pu64BadOffset)
+{
+  uint8_t* pu8Mem = NULL;
+  uint64_t u64Pos = 0;
+  uint64_t u64Chunk = 0;
+  uint32_t i;
+  uint8_t u8RetVal = 1;
+
+  if (u64Bytes == 0)
+  {
+    return 1;
+  }
+  if (posix_memalign((void**)&pu8Mem, ADT_WIPE_CHECK_ALIGN, ADT_WIPE_CHECK_SIZE) != 0)
+  {
+    return 0;
+  }
+  u32Samples = ((u32Samples < 2) ? 2 : u32Samples);
+
+  for (i = 0; (i < u32Samples) && u8RetVal; i++)
+  {
+    u64Chunk = ((u64Bytes > ADT_WIPE_CHECK_SIZE) ? ADT_WIPE_CHECK_SIZE : u64Bytes);
+    u64Pos = ((u64Bytes - u64Chunk) / (u32Samples - 1)) * i;
+    u64Pos = ((i == (u32Samples - 1)) ? (u64Bytes - u64Chunk) :
+	      (u64Pos - (u64Pos % ADT_WIPE_CHECK_ALIGN)));
+    *pu64BadOffset = u64Offset + u64Pos;
+
+    // All zeros if the first is and the rest equal their neighbours
+    u8RetVal = ((pread(iFd, pu8Mem, u64Chunk, u64Offset + u64Pos) == (ssize_t)u64Chunk) &&
+		(pu8Mem[0] == 0) && (memcmp(pu8Mem, pu8Mem + 1, u64Chunk - 1) == 0));
+  }
+  free(pu8Mem);
+
+  return u8RetVal;
+}
+
+// Whether a range wiped this way must read back as zeros. Discarded
+// blocks are undefined, they may give the old data or all ones, unless
+// the queue says discards zero the data. Holes in files always do.
+uint8_t bADT_WipeReadsZero(int iFd, uint8_t u8Wipe)
+{
+  struct stat xStat;
+  FILE* pxFile = NULL;
+  char sPath[PATH_MAX + 48] = { 0 };
+  char sRealPath[PATH_MAX] = { 0 };
+  int iZeroes = 0;
+
+  if ((u8Wipe == ADT_WIPE_ZEROOUT) || (u8Wipe == ADT_WIPE_WRITE))
+  {
+    return 1;
+  }
+  if (fstat(iFd, &xStat) != 0)
+  {
+    return 0;
+  }
+  if (S_ISREG(xStat.st_mode))
+  {
+    return (u8Wipe == ADT_WIPE_DISCARD);
+  }
+  snprintf(sPath, sizeof(sPath), "/sys/dev/block/%u:%u",
+	   major(xStat.st_rdev), minor(xStat.st_rdev));
+
+  if ((!S_ISBLK(xStat.st_mode)) || (realpath(sPath, sRealPath) == NULL))
+  {
+    return 0;
+  }
+  // Partitions have the queue of the whole disk above them
+  snprintf(sPath, sizeof(sPath), "%s/queue/discard_zeroes_data", sRealPath);
+  pxFile = fopen(sPath, "r");
+
+  if (pxFile == NULL)
+  {
+    snprintf(sPath, sizeof(sPath), "%s/../queue/discard_zeroes_data", sRealPath);
+    pxFile = fopen(sPath, "r");
+  }
+  if (pxFile != NULL)
+  {
+    if (fscanf(pxFile, "%d", &iZeroes) != 1)
+    {
+      iZeroes = 0;
+    }
+    fclose(pxFile);
+  }
+
+  return (iZeroes == 1);
+}
+
 // Uses 1024-bases correctly
 void ADT_BytesToHumanReadable(uint64_t u64SizeBytes,
                               char* sHumanReadable)
@@ -184,3 +544,151 @@ void ADT_BytesToHumanReadable(uint64_t u64SizeBytes,
 
   
 }
+
+
+
+// Node of the controller, found by walking up the sysfs device path
+// of the block device. Returns -1 when not known, like for loops.
+int iADT_DeviceNumaNode(int iFd)
+{
+  struct stat xStat;
+  FILE* pxFile = NULL;
+  char sPath[PATH_MAX + 16] = { 0 };
+  char sRealPath[PATH_MAX] = { 0 };
+  char* sSlash = NULL;
+  int iNode = -1;
+
+  if ((fstat(iFd, &xStat) != 0) || (!S_ISBLK(xStat.st_mode)))
+  {
+    return -1;
+  }
+  snprintf(sPath, sizeof(sPath), "/sys/dev/block/%u:%u",
+	   major(xStat.st_rdev), minor(xStat.st_rdev));
+
+  if (realpath(sPath, sRealPath) == NULL)
+  {
+    return -1;
+  }
+  while ((strlen(sRealPath) > strlen("/sys/devices")) && (iNode < 0))
+  {
+    snprintf(sPath, sizeof(sPath), "%s/numa_node", sRealPath);
+    pxFile = fopen(sPath, "r");
+
+    if (pxFile != NULL)
+    {
+      if (fscanf(pxFile, "%d", &iNode) != 1)
+      {
+	iNode = -1;
+      }
+      fclose(pxFile);
+    }
+    sSlash = strrchr(sRealPath, '/');
+
+    if (sSlash == NULL)
+    {
+      break;
+    }
+    *sSlash = 0;
+  }
+
+  return iNode;
+}
+
+
+
+static void* pADT_MemMap(uint64_t u64Bytes, int iExtraFlags)
+{
+  void* pMem = mmap(NULL, u64Bytes, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | iExtraFlags, -1, 0);
+
+  return ((pMem == MAP_FAILED) ? NULL : pMem);
+}
+
+
+
+// Tries 1 GiB and 2 MiB huge pages first, then normal pages with
+// transparent huge pages advised. Memory is placed on the given
+// node if any, faulted in and locked, so no page faults or swap
+// get in the way of timing later on.
+uint8_t bADT_MemAlloc(tAdtMem* pxMem, uint64_t u64Bytes, int iNumaNode)
+{
+  uint64_t u64NodeMask = 0;
+  uint64_t u64PageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+  uint64_t u64Pos = 0;
+
+  memset(pxMem, 0, sizeof(*pxMem));
+
+  if (u64Bytes >= ADT_MEM_HUGE_1G_BYTES)
+  {
+    pxMem->u64MapBytes = (u64Bytes + ADT_MEM_HUGE_1G_BYTES - 1) & ~(ADT_MEM_HUGE_1G_BYTES - 1);
+    pxMem->pMem = pADT_MemMap(pxMem->u64MapBytes, MAP_HUGETLB | (30 << MAP_HUGE_SHIFT));
+    pxMem->u8Flags = ADT_MEM_HUGE_1G;
+  }
+  if (pxMem->pMem == NULL)
+  {
+    pxMem->u64MapBytes = (u64Bytes + ADT_MEM_HUGE_2M_BYTES - 1) & ~(ADT_MEM_HUGE_2M_BYTES - 1);
+    pxMem->pMem = pADT_MemMap(pxMem->u64MapBytes, MAP_HUGETLB | (21 << MAP_HUGE_SHIFT));
+    pxMem->u8Flags = ADT_MEM_HUGE_2M;
+  }
+  if (pxMem->pMem == NULL)
+  {
+    // No huge pages reserved, normal pages it is
+    pxMem->u64MapBytes = (u64Bytes + u64PageSize - 1) & ~(u64PageSize - 1);
+    pxMem->pMem = pADT_MemMap(pxMem->u64MapBytes, 0);
+    pxMem->u8Flags = 0;
+
+    if (pxMem->pMem == NULL)
+    {
+      return 0;
+    }
+    if (madvise(pxMem->pMem, pxMem->u64MapBytes, MADV_HUGEPAGE) == 0)
+    {
+      pxMem->u8Flags |= ADT_MEM_THP;
+    }
+  }
+  if ((iNumaNode >= 0) && (iNumaNode < (int)(8 * sizeof(u64NodeMask))))
+  {
+    // Preferred only, other nodes still better than failing
+    u64NodeMask = ((uint64_t)1) << iNumaNode;
+
+    if (syscall(__NR_mbind, pxMem->pMem, pxMem->u64MapBytes, MPOL_PREFERRED,
+		&u64NodeMask, 8 * sizeof(u64NodeMask), 0) == 0)
+    {
+      pxMem->u8Flags |= ADT_MEM_NUMA;
+    }
+  }
+  // Fault everything in now, on the node asked
+  for (u64Pos = 0; u64Pos < pxMem->u64MapBytes; u64Pos += u64PageSize)
+  {
+    ((volatile uint8_t*)pxMem->pMem)[u64Pos] = 0;
+  }
+  if (mlock(pxMem->pMem, pxMem->u64MapBytes) == 0)
+  {
+    pxMem->u8Flags |= ADT_MEM_LOCKED;
+  }
+
+  return 1;
+}
+
+
+
+void ADT_MemFree(tAdtMem* pxMem)
+{
+  if (pxMem->pMem != NULL)
+  {
+    munmap(pxMem->pMem, pxMem->u64MapBytes);
+  }
+  memset(pxMem, 0, sizeof(*pxMem));
+}
+
+
+
+void ADT_MemDescribe(uint8_t u8Flags, char* sDescription)
+{
+  snprintf(sDescription, ADT_GEN_BUF_SIZE, "%s%s%s",
+	   ((u8Flags & ADT_MEM_HUGE_1G) ? "1 GiB huge pages" :
+	    ((u8Flags & ADT_MEM_HUGE_2M) ? "2 MiB huge pages" :
+	     ((u8Flags & ADT_MEM_THP) ? "transparent huge pages" : "normal pages"))),
+	   ((u8Flags & ADT_MEM_LOCKED) ? ", locked" : ""),
+	   ((u8Flags & ADT_MEM_NUMA) ? ", on the NUMA node of the disk" : ""));
+}
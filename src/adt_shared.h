@@ -10,6 +10,22 @@
 #define ADT_BYTES_IN_GIBIBYTE (((uint32_t)1024)*(ADT_BYTES_IN_MEBIBYTE))
 #define ADT_BYTES_IN_TEBIBYTE (((uint64_t)1024)*(ADT_BYTES_IN_GIBIBYTE))
 
+#define ADT_DEFAULT_BLOCK_SIZE ((uint32_t)512)
+
+#define ADT_MEM_HUGE_1G ((uint8_t)(1 << 0))
+#define ADT_MEM_HUGE_2M ((uint8_t)(1 << 1))
+#define ADT_MEM_THP ((uint8_t)(1 << 2))
+#define ADT_MEM_LOCKED ((uint8_t)(1 << 3))
+#define ADT_MEM_NUMA ((uint8_t)(1 << 4))
+
+// Ways to wipe, the device does all but the zero writes
+#define ADT_WIPE_ZEROOUT ((uint8_t)(0))
+#define ADT_WIPE_DISCARD ((uint8_t)(1))
+#define ADT_WIPE_SECURE ((uint8_t)(2))
+#define ADT_WIPE_WRITE ((uint8_t)(3))
+#define ADT_WIPE_CHECK_SIZE (((uint32_t)64) * ADT_BYTES_IN_KIBIBYTE)
+#define ADT_WIPE_CHECK_ALIGN ((uint32_t)4096) // Fine for O_DIRECT
+
 
 #define ADT_DISK_RAW_INFO_IOCTL_SIZE ((uint16_t)256)
 #define ADT_DISK_INFO_MODEL_LEN ((uint16_t)40)
@@ -20,6 +36,16 @@
 #define ADT_DISK_INFO_FIRMWARE_IOCTL_POS ((uint16_t)23)
 
 
+// Big I/O buffer, mapping may be bigger than asked when on huge pages
+typedef struct
+{
+  void* pMem;
+  uint64_t u64MapBytes;
+  uint8_t u8Flags;
+
+} tAdtMem;
+
+
 void ADT_TrimEnd(char* sParamString);
 void ADT_TrimBegin(char* sParamString);
 void ADT_Trim(char* sParamString);
@@ -29,7 +55,28 @@ uint8_t bADT_IdentifyDisk(int iFd, char* sModel,
                           char* sSerial, char* sFirmware,
                           uint64_t* pu64SizeBytes);
 
+uint8_t bADT_ParseSize(const char* sSizeString, uint64_t* pu64SizeBytes);
+uint8_t bADT_ParseCount(const char* sCountString, uint64_t* pu64Count);
+
+uint8_t bADT_GetBlockSize(int iFd, uint32_t* pu32BlockSize);
+
+uint8_t bADT_PrepareFile(const char* sPath, uint64_t u64SizeBytes, uint8_t* pu8Sparse);
+
+uint8_t bADT_ParseWipe(const char* sWipeString, uint8_t* pu8Wipe);
+const char* sADT_WipeName(uint8_t u8Wipe);
+uint8_t bADT_WipeRange(int iFd, uint64_t u64Offset, uint64_t u64Bytes,
+		       uint8_t u8Wipe, uint8_t* pu8Used);
+uint8_t bADT_CheckZeroed(int iFd, uint64_t u64Offset, uint64_t u64Bytes,
+			 uint32_t u32Samples, uint64_t* pu64BadOffset);
+uint8_t bADT_WipeReadsZero(int iFd, uint8_t u8Wipe);
+
 void ADT_BytesToHumanReadable(uint64_t u64SizeBytes,
 			      char* sHumanReadable);
 
+int iADT_DeviceNumaNode(int iFd);
+
+uint8_t bADT_MemAlloc(tAdtMem* pxMem, uint64_t u64Bytes, int iNumaNode);
+void ADT_MemFree(tAdtMem* pxMem);
+void ADT_MemDescribe(uint8_t u8Flags, char* sDescription);
+
 #endif // #define _ADT_SHARED_H_
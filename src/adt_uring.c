@@ -0,0 +1,222 @@
+#include "adt_uring.h"
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+
+
+void ADT_UringExit(tAdtUring* pxRing)
+{
+  if (pxRing->pxSqes != NULL)
+  {
+    munmap(pxRing->pxSqes, pxRing->xSqesSize);
+  }
+  if ((pxRing->pCqRingMem != NULL) && (pxRing->pCqRingMem != pxRing->pSqRingMem))
+  {
+    munmap(pxRing->pCqRingMem, pxRing->xCqRingSize);
+  }
+  if (pxRing->pSqRingMem != NULL)
+  {
+    munmap(pxRing->pSqRingMem, pxRing->xSqRingSize);
+  }
+  if (pxRing->iRingFd != -1)
+  {
+    close(pxRing->iRingFd);
+  }
+  memset(pxRing, 0, sizeof(*pxRing));
+  pxRing->iRingFd = -1;
+}
+
+
+
+uint8_t bADT_UringInit(tAdtUring* pxRing, uint32_t u32Entries)
+{
+  struct io_uring_params xParams;
+
+  memset(pxRing, 0, sizeof(*pxRing));
+  memset(&xParams, 0, sizeof(xParams));
+
+  pxRing->iRingFd = syscall(__NR_io_uring_setup, u32Entries, &xParams);
+
+  if (pxRing->iRingFd < 0)
+  {
+    pxRing->iRingFd = -1;
+
+    return 0;
+  }
+  pxRing->u32Entries = xParams.sq_entries;
+  pxRing->xSqRingSize = xParams.sq_off.array + (xParams.sq_entries * sizeof(uint32_t));
+  pxRing->xCqRingSize = xParams.cq_off.cqes + (xParams.cq_entries * sizeof(struct io_uring_cqe));
+
+  if (xParams.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    // Both rings live in the same mapping, which needs to fit both
+    if (pxRing->xCqRingSize > pxRing->xSqRingSize)
+    {
+      pxRing->xSqRingSize = pxRing->xCqRingSize;
+    }
+  }
+  pxRing->pSqRingMem = mmap(NULL, pxRing->xSqRingSize, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, pxRing->iRingFd, IORING_OFF_SQ_RING);
+
+  if (pxRing->pSqRingMem == MAP_FAILED)
+  {
+    pxRing->pSqRingMem = NULL;
+    ADT_UringExit(pxRing);
+
+    return 0;
+  }
+  if (xParams.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    pxRing->pCqRingMem = pxRing->pSqRingMem;
+  }
+  else
+  {
+    pxRing->pCqRingMem = mmap(NULL, pxRing->xCqRingSize, PROT_READ | PROT_WRITE,
+			      MAP_SHARED | MAP_POPULATE, pxRing->iRingFd, IORING_OFF_CQ_RING);
+
+    if (pxRing->pCqRingMem == MAP_FAILED)
+    {
+      pxRing->pCqRingMem = NULL;
+      ADT_UringExit(pxRing);
+
+      return 0;
+    }
+  }
+  pxRing->xSqesSize = xParams.sq_entries * sizeof(struct io_uring_sqe);
+  pxRing->pxSqes = mmap(NULL, pxRing->xSqesSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, pxRing->iRingFd, IORING_OFF_SQES);
+
+  if (pxRing->pxSqes == MAP_FAILED)
+  {
+    pxRing->pxSqes = NULL;
+    ADT_UringExit(pxRing);
+
+    return 0;
+  }
+  pxRing->pu32SqHead = pxRing->pSqRingMem + xParams.sq_off.head;
+  pxRing->pu32SqTail = pxRing->pSqRingMem + xParams.sq_off.tail;
+  pxRing->pu32SqMask = pxRing->pSqRingMem + xParams.sq_off.ring_mask;
+  pxRing->pu32SqArray = pxRing->pSqRingMem + xParams.sq_off.array;
+  pxRing->pu32CqHead = pxRing->pCqRingMem + xParams.cq_off.head;
+  pxRing->pu32CqTail = pxRing->pCqRingMem + xParams.cq_off.tail;
+  pxRing->pu32CqMask = pxRing->pCqRingMem + xParams.cq_off.ring_mask;
+  pxRing->pxCqes = pxRing->pCqRingMem + xParams.cq_off.cqes;
+
+  return 1;
+}
+
+
+
+uint8_t bADT_UringQueueRw(tAdtUring* pxRing, int iFd, void* pBufMem,
+			  uint32_t u32Bytes, uint64_t u64Offset,
+			  uint8_t u8Write, uint64_t u64UserData)
+{
+  uint32_t u32Tail = *(pxRing->pu32SqTail);
+  uint32_t u32Index = 0;
+  struct io_uring_sqe* pxSqe = NULL;
+
+  if ((u32Tail - __atomic_load_n(pxRing->pu32SqHead, __ATOMIC_ACQUIRE)) >= pxRing->u32Entries)
+  {
+    // Submission ring full
+    return 0;
+  }
+  u32Index = u32Tail & *(pxRing->pu32SqMask);
+  pxSqe = &(pxRing->pxSqes[u32Index]);
+  memset(pxSqe, 0, sizeof(*pxSqe));
+  pxSqe->opcode = (u8Write ? IORING_OP_WRITE : IORING_OP_READ);
+  pxSqe->fd = iFd;
+  pxSqe->addr = (uint64_t)(uintptr_t)pBufMem;
+  pxSqe->len = u32Bytes;
+  pxSqe->off = u64Offset;
+  pxSqe->user_data = u64UserData;
+  pxRing->pu32SqArray[u32Index] = u32Index;
+
+  // Kernel must see the entry before the new tail
+  __atomic_store_n(pxRing->pu32SqTail, u32Tail + 1, __ATOMIC_RELEASE);
+  pxRing->u32ToSubmit++;
+
+  return 1;
+}
+
+
+
+// Submits everything queued and waits until at least u32WaitNr
+// completions are available. Returns negative errno on failure.
+int iADT_UringSubmit(tAdtUring* pxRing, uint32_t u32WaitNr)
+{
+  int iRet = 0;
+
+  do
+  {
+    iRet = syscall(__NR_io_uring_enter, pxRing->iRingFd, pxRing->u32ToSubmit,
+		   u32WaitNr, (u32WaitNr ? IORING_ENTER_GETEVENTS : 0), NULL, 0);
+  }
+  while ((iRet < 0) && (errno == EINTR));
+
+  if (iRet < 0)
+  {
+    return -errno;
+  }
+  pxRing->u32ToSubmit -= ((iRet > pxRing->u32ToSubmit) ? pxRing->u32ToSubmit : iRet);
+
+  return iRet;
+}
+
+
+
+uint8_t bADT_UringReap(tAdtUring* pxRing, uint64_t* pu64UserData,
+		       int32_t* pi32Result)
+{
+  uint32_t u32Head = *(pxRing->pu32CqHead);
+  struct io_uring_cqe* pxCqe = NULL;
+
+  if (u32Head == __atomic_load_n(pxRing->pu32CqTail, __ATOMIC_ACQUIRE))
+  {
+    // Nothing completed
+    return 0;
+  }
+  pxCqe = &(pxRing->pxCqes[u32Head & *(pxRing->pu32CqMask)]);
+  *pu64UserData = pxCqe->user_data;
+  *pi32Result = pxCqe->res;
+
+  // Entry consumed, kernel may reuse it
+  __atomic_store_n(pxRing->pu32CqHead, u32Head + 1, __ATOMIC_RELEASE);
+
+  return 1;
+}
+
+
+
+// For giving up after a failed submit. Entries the kernel never took
+// are taken back, the rest waited out, so that no buffer is left in
+// use by the kernel. u32InFlight is all queued and not yet reaped.
+void ADT_UringDrain(tAdtUring* pxRing, uint32_t u32InFlight)
+{
+  uint32_t u32Tail = *(pxRing->pu32SqTail);
+  uint32_t u32Unseen = u32Tail - __atomic_load_n(pxRing->pu32SqHead, __ATOMIC_ACQUIRE);
+  uint64_t u64UserData = 0;
+  int32_t i32Result = 0;
+  struct timespec xPause = { 0, 1000000 };
+
+  __atomic_store_n(pxRing->pu32SqTail, u32Tail - u32Unseen, __ATOMIC_RELEASE);
+  pxRing->u32ToSubmit = 0;
+  u32InFlight -= ((u32Unseen > u32InFlight) ? u32InFlight : u32Unseen);
+
+  while (u32InFlight > 0)
+  {
+    if (bADT_UringReap(pxRing, &u64UserData, &i32Result))
+    {
+      u32InFlight--;
+    }
+    else if (iADT_UringSubmit(pxRing, 1) < 0)
+    {
+      // Completions still get posted, just poll for them
+      nanosleep(&xPause, NULL);
+    }
+  }
+}
@@ -0,0 +1,49 @@
+#ifndef _ADT_URING_H_
+#define _ADT_URING_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+
+// Bare bones io_uring over raw syscalls, so we need no liburing.
+// Single submitter, single reaper, no SQ polling.
+typedef struct
+{
+  int iRingFd;
+  uint32_t u32Entries;
+  uint32_t u32ToSubmit;
+
+  // Submission ring
+  void* pSqRingMem;
+  size_t xSqRingSize;
+  uint32_t* pu32SqHead;
+  uint32_t* pu32SqTail;
+  uint32_t* pu32SqMask;
+  uint32_t* pu32SqArray;
+  struct io_uring_sqe* pxSqes;
+  size_t xSqesSize;
+
+  // Completion ring
+  void* pCqRingMem;
+  size_t xCqRingSize;
+  uint32_t* pu32CqHead;
+  uint32_t* pu32CqTail;
+  uint32_t* pu32CqMask;
+  struct io_uring_cqe* pxCqes;
+
+} tAdtUring;
+
+
+uint8_t bADT_UringInit(tAdtUring* pxRing, uint32_t u32Entries);
+void ADT_UringExit(tAdtUring* pxRing);
+
+uint8_t bADT_UringQueueRw(tAdtUring* pxRing, int iFd, void* pBufMem,
+			  uint32_t u32Bytes, uint64_t u64Offset,
+			  uint8_t u8Write, uint64_t u64UserData);
+int iADT_UringSubmit(tAdtUring* pxRing, uint32_t u32WaitNr);
+uint8_t bADT_UringReap(tAdtUring* pxRing, uint64_t* pu64UserData,
+		       int32_t* pi32Result);
+void ADT_UringDrain(tAdtUring* pxRing, uint32_t u32InFlight);
+
+#endif // #define _ADT_URING_H_
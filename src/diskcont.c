@@ -1,11 +1,19 @@
+#define _GNU_SOURCE // For O_DIRECT
+
 #include "adt_shared.h"
+#include "adt_uring.h"
+#include "adt_pattern.h"
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <time.h>
+#include <math.h>
 #include <semaphore.h>
 #include <pthread.h>
 
@@ -14,26 +22,296 @@
 #define ADT_DC_RUNNING_NUM_SIZE_BYTES ((uint64_t)(8))
 #define ADT_DC_PROGRESS_UPDATE_INTERVAL ((uint32_t)(5))
 #define ADT_DC_DEFAULT_BUF_SIZE (((uint32_t)(100)) * ADT_BYTES_IN_MEBIBYTE)
+#define ADT_DC_DEFAULT_BUF_COUNT ((uint32_t)(2))
+#define ADT_DC_MIN_BUF_SIZE (((uint32_t)(64)) * ADT_BYTES_IN_KIBIBYTE)
+#define ADT_DC_MAX_BUF_SIZE (((uint32_t)(1024)) * ADT_BYTES_IN_MEBIBYTE)
+#define ADT_DC_MAX_BUF_COUNT ((uint32_t)(1024))
+#define ADT_DC_MAX_DEFAULT_GEN_THREADS ((uint32_t)(4))
+#define ADT_DC_MAX_GEN_THREADS ((uint32_t)(256))
+#define ADT_DC_GEN_SLICE_ALIGN ((uint64_t)(4096))
+#define ADT_DC_GEN_JOB_FILL ((uint8_t)(0))
+#define ADT_DC_GEN_JOB_VERIFY ((uint8_t)(1))
+#define ADT_DC_EXTENT_WRITE_ERROR ((uint8_t)(0))
+#define ADT_DC_EXTENT_READ_ERROR ((uint8_t)(1))
+#define ADT_DC_EXTENT_MISMATCH ((uint8_t)(2))
+#define ADT_DC_EXTENT_BAD_CRC ((uint8_t)(3))
+#define ADT_DC_EXTENT_MISDIRECTED ((uint8_t)(4))
+#define ADT_DC_EXTENT_STALE ((uint8_t)(5))
+#define ADT_DC_EXTENT_ALLOC_STEP ((uint32_t)(256))
+#define ADT_DC_RETRY_SPLIT ((uint64_t)(16))
+#define ADT_DC_DEFAULT_BADBLOCK_SIZE ((uint32_t)(1024))
+#define ADT_DC_DEFAULT_QUEUE_DEPTH ((uint32_t)(32))
+#define ADT_DC_MAX_QUEUE_DEPTH ((uint32_t)(4096))
+#define ADT_DC_DEFAULT_IO_SIZE (((uint32_t)(1)) * ADT_BYTES_IN_MEBIBYTE)
+#define ADT_DC_URING_PENDING INT32_MIN
+#define ADT_DC_MAX_DEVICES ((uint32_t)(256))
+#define ADT_DC_MAX_STRIPES ((uint32_t)(64))
+#define ADT_DC_STRIPE_ALIGN ((uint64_t)(ADT_BYTES_IN_MEBIBYTE))
+#define ADT_DC_CHECKPOINT_INTERVAL ((uint32_t)(60))
+#define ADT_DC_CHECKPOINT_MAGIC "diskcont checkpoint 1"
+#define ADT_DC_DEFAULT_STREAM_INTERVAL_MS ((uint32_t)(1000))
+#define ADT_DC_MIN_STREAM_INTERVAL_MS ((uint32_t)(10))
+#define ADT_DC_STREAM_JSON ((uint8_t)(0))
+#define ADT_DC_STREAM_CSV ((uint8_t)(1))
+#define ADT_DC_LATENCY_SUB_BITS ((uint32_t)(3))
+#define ADT_DC_LATENCY_BUCKETS ((uint32_t)((64 - ADT_DC_LATENCY_SUB_BITS + 1) << ADT_DC_LATENCY_SUB_BITS))
+#define ADT_DC_LATENCY_WORST ((uint32_t)(10))
+#define ADT_DC_DEFAULT_ZONES ((uint32_t)(100))
+#define ADT_DC_MAX_ZONES ((uint32_t)(100000))
+#define ADT_DC_DEFAULT_SLOW_ZONE_PERCENT ((uint32_t)(50))
+#define ADT_DC_ZONE_NEIGHBOURS ((uint32_t)(2))
+#define ADT_DC_TUNE_REGION (((uint64_t)(64)) * ADT_BYTES_IN_MEBIBYTE)
+#define ADT_DC_TUNE_TIME_MS ((uint64_t)(300))
+#define ADT_DC_TUNE_GOOD_PERCENT ((uint32_t)(95))
+#define ADT_DC_PHASE_IDLE ((uint8_t)(0))
+#define ADT_DC_PHASE_WRITE ((uint8_t)(1))
+#define ADT_DC_PHASE_READ ((uint8_t)(2))
+#define ADT_DC_PHASE_DONE ((uint8_t)(3))
+#define ADT_DC_PHASE_FAILED ((uint8_t)(4))
+#define ADT_DC_PHASE_COMBINED ((uint8_t)(5))
+#define ADT_DC_FOLLOW_POLL_NS ((long)(10000000))
+#define ADT_DC_MAX_SAMPLE_MEM (((uint64_t)(1024)) * ADT_BYTES_IN_MEBIBYTE)
+#define ADT_DC_DIRTY_WINDOW (((uint64_t)(256)) * ADT_BYTES_IN_MEBIBYTE)
+#define ADT_DC_WIPE_CHUNK ((uint64_t)ADT_BYTES_IN_GIBIBYTE)
+#define ADT_DC_WIPE_CHECKS ((uint32_t)(256))
+#define ADT_DC_SAMPLE_CONFIDENCE ((double)(0.95))
+#define ADT_DC_SAMPLE_Z ((double)(1.645)) // One sided 95%
+
+
+
+typedef struct
+{
+  uint64_t u64Begin;
+  uint64_t u64End;
+  uint8_t u8Kind;
+
+} tDcExtent;
+
+
+
+typedef struct
+{
+  void* pMem;
+  uint64_t u64Offset;
+  uint64_t u64Bytes;
+  tAdtMem xMem;
+
+  // Read errors already recorded, verifier skips these
+  tDcExtent* pxSkips;
+  uint32_t u32SkipCount;
+  uint32_t u32SkipCapacity;
+
+} tDcBuffer;
+
+
+
+// Lock-free single producer / single consumer queue. The
+// semaphore only counts items so an empty queue can be slept on.
+typedef struct
+{
+  uint32_t u32Capacity;
+  uint32_t u32Head;
+  uint32_t u32Tail;
+  void** ppSlots;
+  sem_t xSemItems;
+
+} tDcQueue;
+
+
+
+// Buffers shared by all devices tested at the same time, so memory
+// use stays bounded no matter how many devices there are.
+typedef struct
+{
+  pthread_mutex_t xMutex;
+  pthread_cond_t xCond;
+  tDcBuffer* pxBufs;
+  uint32_t u32BufCount;
+  tDcBuffer** ppxFree;
+  uint32_t u32FreeCount;
+
+} tDcPool;
+
+
+
+typedef struct
+{
+  uint64_t u64Nanos;
+  uint64_t u64Offset;
+  uint64_t u64Bytes;
+
+} tDcSlowIo;
 
 
 
+// Log bucketed with 8 sub-buckets per power of two, so values are
+// within 12.5%. Counting is lock-free, only an operation slower than
+// all the worst ones so far takes the mutex to get listed.
 typedef struct
+{
+  uint64_t au64Buckets[ADT_DC_LATENCY_BUCKETS];
+  uint64_t u64Count;
+  uint64_t u64MaxNanos;
+  uint64_t u64WorstFloorNanos;
+  tDcSlowIo axWorst[ADT_DC_LATENCY_WORST];
+  uint32_t u32WorstCount;
+
+} tDcLatency;
+
+
+
+// One phase of one LBA zone. Time is from the first I/O starting
+// to the last ending, so overlapping I/Os are not counted twice.
+typedef struct
+{
+  uint64_t u64Bytes;
+  uint64_t u64IoCount;
+  uint64_t u64FirstStartNanos;
+  uint64_t u64LastEndNanos;
+  uint64_t u64SumNanos;
+  uint64_t u64MaxNanos;
+
+} tDcZone;
+
+
+
+struct tDcStateTag;
+
+typedef struct
+{
+  struct tDcStateTag* pxState;
+  uint32_t u32Slice;
+  pthread_t xThread;
+  sem_t xSemStart;
+
+  // Verification result of the slice
+  uint64_t u64BadOffset;
+  uint64_t u64Expected;
+  uint64_t u64Actual;
+  uint8_t u8Kind;
+
+} tDcGenWorker;
+
+
+
+typedef struct tDcStateTag
 {
   uint8_t u8Silent;
   uint8_t u8Write;
   uint8_t u8Read;
+  uint8_t u8Direct;
+  uint8_t u8Uring;
+  uint8_t u8NonTemporal;
+  uint8_t u8Continue;
+  uint8_t u8OffsetKeyed;
+  uint8_t u8Random;
+  uint8_t u8Sectors;
+  uint8_t u8SeedGiven;
+  uint8_t u8PassGiven;
+  uint32_t u32Pass;
   uint8_t u8ThreadError;
   uint32_t u32BufSize;
+  uint32_t u32BlockSize;
+  uint32_t u32QueueDepth;
+  uint32_t u32IoSize;
+  uint32_t u32BufCount;
+  uint32_t u32GenThreads;
+  uint64_t u64Seed;
   char sDevice[ADT_GEN_BUF_SIZE];
+  char** psDevices;
+  uint32_t u32DeviceCount;
+  uint8_t u8BufCountGiven;
+  uint8_t u8BufSizeGiven;
+  uint8_t u8IoSizeGiven;
+  uint8_t u8QueueDepthGiven;
+  uint8_t u8Tune;
+  uint8_t u8GenThreadsGiven;
+  uint32_t u32Stripes;
+  uint8_t u8Sample;
+  uint64_t u64SampleCount;
+  double fSamplePercent;
+  uint8_t u8Wipe;
+  uint8_t u8WipeWay;
+  uint64_t u64FileSizeBytes;
   uint64_t u64DevSizeBytes;
+  uint64_t u64TotalBytes;
+  int iNumaNode;
+  uint64_t u64RegionBegin;
+  uint64_t u64RegionEnd;
+  struct tDcStateTag* pxParent;
+  uint8_t u8StripeFailed;
+
+  // Write and read at once, reader following the writer by a lag
+  uint8_t u8Combined;
+  uint64_t u64VerifyLagBytes;
+  struct tDcStateTag* pxLeader;
+  uint64_t u64WrittenOffset;
+  uint64_t u64EvictedOffset;
   int iFd;
+  tAdtUring xUring;
+  int32_t* pi32UringResults;
+  uint64_t* pu64UringStartNanos;
   pthread_t xAllocatorThread;
-  sem_t xSemThread;
-  sem_t xSemBuffer0;
-  sem_t xSemBuffer1;
-  void* apMemBufs[2];
-  uint8_t u8WantBuffer;
-  uint64_t u64CurrNumber;
+  tDcBuffer* pxBufs;
+  tDcQueue xFreeQueue;
+  tDcQueue xFullQueue;
+  tDcPool* pxPool;
+  uint8_t u8PipelineRunning;
+  uint8_t u8Abort;
+  uint8_t u8PipelineWrite;
+  uint8_t u8VerifyFailed;
+  uint64_t u64GenOffset;
+  uint64_t u64BadOffset;
+  uint64_t u64BadExpected;
+  uint64_t u64BadActual;
+  uint8_t u8BadKind;
+
+  // Bad extents, only gathered when continuing on errors
+  uint8_t u8MismatchSeen;
+  tDcExtent* pxExtents;
+  uint32_t u32ExtentCount;
+  uint32_t u32ExtentCapacity;
+  pthread_mutex_t xExtentMutex;
+  char sBadBlocksFile[ADT_GEN_BUF_SIZE];
+  uint32_t u32BadBlockSize;
+
+  // Checkpoints, durable offset is where a resume may start from
+  char sStateFile[ADT_GEN_BUF_SIZE];
+  char sSerial[ADT_DISK_INFO_SERIAL_LEN + 1];
+  uint8_t u8Resume;
+  uint8_t u8ResumePhase;
+  uint64_t* pu64ResumeOffsets;
+  uint64_t u64DurableOffset;
+  uint64_t u64VerifiedOffset;
+  struct timeval xCheckpointTime;
+
+  // Machine readable progress, sampled by a thread of its own
+  char sStreamFile[ADT_GEN_BUF_SIZE];
+  uint8_t u8StreamFormat;
+  uint32_t u32StreamIntervalMs;
+  uint32_t au32ErrorCounts[3];
+
+  // Latency of every single I/O, by read (0) and write (1)
+  tDcLatency axLatency[2];
+  pthread_mutex_t xLatencyMutex;
+
+  // Speed by LBA zone, read zones first and then write zones
+  char sZoneFile[ADT_GEN_BUF_SIZE];
+  uint32_t u32Zones;
+  uint32_t u32SlowZonePercent;
+  uint64_t u64ZoneBytes;
+  tDcZone* pxZones;
+
+  // Generation worker pool and the job it works on
+  tDcGenWorker* pxGenWorkers;
+  uint32_t u32GenSlices;
+  sem_t xSemGenDone;
+  uint8_t u8GenExit;
+  uint8_t u8GenJob;
+  void* pGenMem;
+  uint64_t u64GenBytes;
+  uint64_t u64GenNumber;
+  uint8_t u8GenBadKind;
 
   // Rest used for status printing:
   struct timeval xStartTime;
@@ -41,32 +319,116 @@ typedef struct
   struct timeval xNowTime;
   uint64_t u64NowDataLeftBytes;
   uint64_t u64LastDataLeftBytes;
+  uint64_t u64StartDataLeftBytes;
+
+  // Multiple device run, progress is shown by main thread
+  uint8_t u8Multi;
+  uint8_t u8Phase;
+  uint8_t u8Result;
+  pthread_t xDeviceThread;
+  uint8_t u8ShownPhase;
+  struct timeval xShownTime;
+  uint64_t u64ShownDataLeftBytes;
   
 } tDcState;
 
 
 
+// Samples the counters of the devices, never touches the I/O itself
+typedef struct
+{
+  tDcState** ppxStates;
+  uint32_t u32Count;
+  FILE* pxFile;
+  uint8_t u8Format;
+  uint32_t u32IntervalMs;
+  uint8_t u8Exit;
+  pthread_t xThread;
+  struct timeval xStartTime;
+  struct timeval* pxLastTimes;
+  uint64_t* pu64LastLeftBytes;
+  uint8_t* pu8LastPhases;
+
+} tDcStreamer;
+
+
+
+static const char* asDcPhaseNames[] = { "idle", "write", "read", "done", "failed", "write+read" };
+
+// By ADT_PATTERN_BAD_*
+static const char* asDcBadKinds[] = { "wrong data", "bad checksum, bit rot",
+				      "misdirected write", "stale data from another run" };
+
+
+
+// Bumped on every message printed while devices run in parallel,
+// so that the progress display knows not to draw over them.
+static uint32_t u32DcMessages = 0;
+
+
+
 static uint8_t bDC_GetParams(int argc, char* argv[], tDcState* pxState)
 {
-  uint8_t i;
+  uint32_t i;
+  uint32_t u32Pipelines = 0;
   uint8_t u8WriteFound = 0;
   uint8_t u8ReadFound = 0;
+  uint64_t u64Temp = 0;
+  char* sEnd = NULL;
+  long iCpus = sysconf(_SC_NPROCESSORS_ONLN);
 
   // Default settings
   pxState->u8Silent = 0;
   pxState->u8Write = 1;
   pxState->u8Read = 1;
+  pxState->u8Direct = 0;
+  pxState->u8Uring = 0;
+  pxState->u8NonTemporal = 0;
+  pxState->u8Continue = 0;
+  pxState->u8OffsetKeyed = 0;
+  pxState->u8Random = 0;
+  pxState->u8Sectors = 0;
+  pxState->u8SeedGiven = 0;
+  pxState->u8PassGiven = 0;
+  pxState->u32Pass = 0;
+  pxState->u64Seed = 0;
+  pxState->u32BadBlockSize = ADT_DC_DEFAULT_BADBLOCK_SIZE;
   pxState->u32BufSize = ADT_DC_DEFAULT_BUF_SIZE;
+  pxState->u32BlockSize = ADT_DEFAULT_BLOCK_SIZE;
+  pxState->u32QueueDepth = ADT_DC_DEFAULT_QUEUE_DEPTH;
+  pxState->u32IoSize = ADT_DC_DEFAULT_IO_SIZE;
+  pxState->u32BufCount = ADT_DC_DEFAULT_BUF_COUNT;
+  pxState->u32GenThreads = (((iCpus > 0) && (iCpus < ADT_DC_MAX_DEFAULT_GEN_THREADS)) ?
+			    (uint32_t)iCpus : ADT_DC_MAX_DEFAULT_GEN_THREADS);
+  pxState->u32Stripes = 1;
+  pxState->u8Sample = 0;
+  pxState->u64SampleCount = 0;
+  pxState->fSamplePercent = 0.0;
+  pxState->u8Wipe = 0;
+  pxState->u8WipeWay = ADT_WIPE_ZEROOUT;
+  pxState->u64FileSizeBytes = 0;
+  pxState->u8Combined = 0;
+  pxState->u64VerifyLagBytes = 0;
 
   memset(pxState->sDevice, 0, ADT_GEN_BUF_SIZE);
+  memset(pxState->sBadBlocksFile, 0, ADT_GEN_BUF_SIZE);
+  memset(pxState->sStateFile, 0, ADT_GEN_BUF_SIZE);
+  memset(pxState->sStreamFile, 0, ADT_GEN_BUF_SIZE);
+  memset(pxState->sZoneFile, 0, ADT_GEN_BUF_SIZE);
+  pxState->u32Zones = ADT_DC_DEFAULT_ZONES;
+  pxState->u32SlowZonePercent = ADT_DC_DEFAULT_SLOW_ZONE_PERCENT;
+  pxState->u8StreamFormat = ADT_DC_STREAM_JSON;
+  pxState->u32StreamIntervalMs = ADT_DC_DEFAULT_STREAM_INTERVAL_MS;
+  pxState->u32DeviceCount = 0;
+  pxState->psDevices = calloc(argc, sizeof(char*));
 
-  if (argc < 2)
+  if ((argc < 2) || (pxState->psDevices == NULL))
   {
     // Device not given and argc generally too small
     return 0;
   }
 
-  for (i = 1; i < (argc - 1); i++)
+  for (i = 1; i < (uint32_t)argc; i++)
   {
     if (strcmp("-r", argv[i]) == 0)
     {
@@ -80,13 +442,301 @@ static uint8_t bDC_GetParams(int argc, char* argv[], tDcState* pxState)
     {
       pxState->u8Silent = 1;
     }
-    else
+    else if (strcmp("-d", argv[i]) == 0)
+    {
+      pxState->u8Direct = 1;
+    }
+    else if (strcmp("-u", argv[i]) == 0)
+    {
+      pxState->u8Uring = 1;
+    }
+    else if (strcmp("-n", argv[i]) == 0)
+    {
+      pxState->u8NonTemporal = 1;
+    }
+    else if (strcmp("-c", argv[i]) == 0)
+    {
+      pxState->u8Continue = 1;
+    }
+    else if (strcmp("-o", argv[i]) == 0)
+    {
+      pxState->u8OffsetKeyed = 1;
+    }
+    else if (strcmp("-R", argv[i]) == 0)
+    {
+      pxState->u8Random = 1;
+    }
+    else if (strcmp("-C", argv[i]) == 0)
+    {
+      pxState->u8Sectors = 1;
+    }
+    else if ((strcmp("-N", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseCount(argv[i], &u64Temp)) || (u64Temp > UINT32_MAX))
+      {
+	return 0;
+      }
+      pxState->u32Pass = (uint32_t)u64Temp;
+      pxState->u8PassGiven = 1;
+    }
+    else if ((strcmp("-x", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+      pxState->u64Seed = strtoull(argv[i], &sEnd, 0);
+      pxState->u8SeedGiven = 1;
+
+      if ((argv[i][0] == 0) || (*sEnd != 0))
+      {
+	return 0;
+      }
+    }
+    else if ((strcmp("-W", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if (!bADT_ParseWipe(argv[i], &(pxState->u8WipeWay)))
+      {
+	return 0;
+      }
+      pxState->u8Wipe = 1;
+    }
+    else if ((strcmp("-f", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseSize(argv[i], &(pxState->u64FileSizeBytes))) ||
+	  (pxState->u64FileSizeBytes == 0))
+      {
+	return 0;
+      }
+    }
+    else if ((strcmp("-l", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if (strlen(argv[i]) >= ADT_GEN_BUF_SIZE)
+      {
+	return 0;
+      }
+      strcpy(pxState->sBadBlocksFile, argv[i]);
+    }
+    else if ((strcmp("-S", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if (strlen(argv[i]) >= ADT_GEN_BUF_SIZE)
+      {
+	return 0;
+      }
+      strcpy(pxState->sStateFile, argv[i]);
+    }
+    else if ((strcmp("-P", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if (strlen(argv[i]) >= ADT_GEN_BUF_SIZE)
+      {
+	return 0;
+      }
+      strcpy(pxState->sStreamFile, argv[i]);
+    }
+    else if ((strcmp("-F", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if (strcmp("json", argv[i]) == 0)
+      {
+	pxState->u8StreamFormat = ADT_DC_STREAM_JSON;
+      }
+      else if (strcmp("csv", argv[i]) == 0)
+      {
+	pxState->u8StreamFormat = ADT_DC_STREAM_CSV;
+      }
+      else
+      {
+	return 0;
+      }
+    }
+    else if ((strcmp("-I", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseCount(argv[i], &u64Temp)) ||
+	  (u64Temp < ADT_DC_MIN_STREAM_INTERVAL_MS) || (u64Temp > UINT32_MAX))
+      {
+	return 0;
+      }
+      pxState->u32StreamIntervalMs = (uint32_t)u64Temp;
+    }
+    else if ((strcmp("-M", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if (strlen(argv[i]) >= ADT_GEN_BUF_SIZE)
+      {
+	return 0;
+      }
+      strcpy(pxState->sZoneFile, argv[i]);
+    }
+    else if ((strcmp("-z", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseCount(argv[i], &u64Temp)) || (u64Temp == 0) ||
+	  (u64Temp > ADT_DC_MAX_ZONES))
+      {
+	return 0;
+      }
+      pxState->u32Zones = (uint32_t)u64Temp;
+    }
+    else if ((strcmp("-m", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseCount(argv[i], &u64Temp)) || (u64Temp == 0) || (u64Temp >= 100))
+      {
+	return 0;
+      }
+      pxState->u32SlowZonePercent = (uint32_t)u64Temp;
+    }
+    else if (strcmp("--resume", argv[i]) == 0)
+    {
+      pxState->u8Resume = 1;
+    }
+    else if ((strcmp("-L", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseSize(argv[i], &u64Temp)) ||
+	  (u64Temp == 0) || (u64Temp > ADT_DC_DEFAULT_BUF_SIZE))
+      {
+	return 0;
+      }
+      pxState->u32BadBlockSize = (uint32_t)u64Temp;
+    }
+    else if ((strcmp("-q", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseCount(argv[i], &u64Temp)) ||
+	  (u64Temp == 0) || (u64Temp > ADT_DC_MAX_QUEUE_DEPTH))
+      {
+	return 0;
+      }
+      pxState->u32QueueDepth = (uint32_t)u64Temp;
+      pxState->u8QueueDepthGiven = 1;
+    }
+    else if ((strcmp("-k", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseCount(argv[i], &u64Temp)) ||
+	  (u64Temp < 2) || (u64Temp > ADT_DC_MAX_BUF_COUNT))
+      {
+	return 0;
+      }
+      pxState->u32BufCount = (uint32_t)u64Temp;
+      pxState->u8BufCountGiven = 1;
+    }
+    else if ((strcmp("-t", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseCount(argv[i], &u64Temp)) ||
+	  (u64Temp == 0) || (u64Temp > ADT_DC_MAX_GEN_THREADS))
+      {
+	return 0;
+      }
+      pxState->u32GenThreads = (uint32_t)u64Temp;
+      pxState->u8GenThreadsGiven = 1;
+    }
+    else if ((strcmp("-p", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseCount(argv[i], &u64Temp)) ||
+	  (u64Temp == 0) || (u64Temp > ADT_DC_MAX_STRIPES))
+      {
+	return 0;
+      }
+      pxState->u32Stripes = (uint32_t)u64Temp;
+    }
+    else if ((strcmp("-V", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if (!bADT_ParseSize(argv[i], &(pxState->u64VerifyLagBytes)))
+      {
+	return 0;
+      }
+      pxState->u8Combined = 1;
+    }
+    else if ((strcmp("-i", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseSize(argv[i], &u64Temp)) ||
+	  (u64Temp < ADT_DC_RUNNING_NUM_SIZE_BYTES) || (u64Temp > ADT_DC_DEFAULT_BUF_SIZE))
+      {
+	return 0;
+      }
+      pxState->u32IoSize = (uint32_t)u64Temp;
+      pxState->u8IoSizeGiven = 1;
+    }
+    else if ((strcmp("-b", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseSize(argv[i], &u64Temp)) ||
+	  (u64Temp < ADT_DC_MIN_BUF_SIZE) || (u64Temp > ADT_DC_MAX_BUF_SIZE))
+      {
+	return 0;
+      }
+      // Generation slices are aligned to this
+      pxState->u32BufSize = (uint32_t)(u64Temp & ~(ADT_DC_GEN_SLICE_ALIGN - 1));
+      pxState->u8BufSizeGiven = 1;
+    }
+    else if (strcmp("-T", argv[i]) == 0)
+    {
+      pxState->u8Tune = 1;
+    }
+    else if ((strcmp("-a", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+      pxState->u8Sample = 1;
+
+      if ((argv[i][0] != 0) && (argv[i][strlen(argv[i]) - 1] == '%'))
+      {
+	pxState->fSamplePercent = strtod(argv[i], &sEnd);
+
+	if ((sEnd != (argv[i] + strlen(argv[i]) - 1)) ||
+	    (!(pxState->fSamplePercent > 0.0)) || (pxState->fSamplePercent > 100.0))
+	{
+	  return 0;
+	}
+      }
+      else if ((!bADT_ParseCount(argv[i], &(pxState->u64SampleCount))) ||
+	       (pxState->u64SampleCount == 0))
+      {
+	return 0;
+      }
+    }
+    else if ((strncmp(argv[i], "-", 1) == 0) ||
+	     (strlen(argv[i]) >= ADT_GEN_BUF_SIZE) ||
+	     (pxState->u32DeviceCount >= ADT_DC_MAX_DEVICES))
     {
       // Wrong parameter
       
       return 0;
     }
-
+    else
+    {
+      // Anything else is a device
+      pxState->psDevices[pxState->u32DeviceCount] = argv[i];
+      pxState->u32DeviceCount++;
+    }
   }
   if (u8WriteFound + u8ReadFound)
   {
@@ -98,517 +748,3602 @@ static uint8_t bDC_GetParams(int argc, char* argv[], tDcState* pxState)
     pxState->u8Read = u8ReadFound;
   }
 
-  if ((strcmp(argv[argc - 1], "-r") == 0) ||
-      (strcmp(argv[argc - 1], "-w") == 0) ||
-      (strcmp(argv[argc - 1], "-s") == 0) ||
-      (strncmp(argv[argc - 1], "-", 1) == 0))
+  if ((pxState->u32DeviceCount == 0) ||
+      (pxState->u8Resume && (pxState->sStateFile[0] == 0)))
   {
-    // No device given
+    // No device given, or nothing to resume from
     return 0;
   }
+  if (pxState->u8Combined &&
+      ((!pxState->u8Write) || (!pxState->u8Read) ||
+       (pxState->u32Stripes > 1) || (pxState->sStateFile[0] != 0)))
+  {
+    // Needs both phases, and has no single place to resume from
+    return 0;
+  }
+  if (pxState->u8Sample)
+  {
+    if (u8WriteFound || pxState->u8Combined ||
+	(pxState->u32Stripes > 1) || (pxState->sStateFile[0] != 0))
+    {
+      // Reads only, and is over before there is anything to resume
+      return 0;
+    }
+    if (pxState->u8Sectors && (pxState->u32IoSize % ADT_PATTERN_SECTOR_SIZE))
+    {
+      // Part of a headered sector can never verify
+      return 0;
+    }
+    // Random reads need many in flight to be quick
+    pxState->u8Write = 0;
+    pxState->u8Read = 1;
+    pxState->u8Uring = 1;
+  }
+  if (pxState->u8Wipe)
+  {
+    if (u8ReadFound || pxState->u8Sample || pxState->u8Combined || pxState->u8Sectors ||
+	(pxState->u32Stripes > 1) || (pxState->sStateFile[0] != 0))
+    {
+      // Not a test, just a one go wipe
+      return 0;
+    }
+    pxState->u8Write = 1;
+    pxState->u8Read = 0;
+  }
   // Device given.
-  strcpy(pxState->sDevice, argv[argc - 1]);
+  strcpy(pxState->sDevice, pxState->psDevices[0]);
+
+  // Every stripe of every device runs a pipeline of its own
+  u32Pipelines = pxState->u32DeviceCount * pxState->u32Stripes * (pxState->u8Combined ? 2 : 1);
+
+  if (u32Pipelines > 1)
+  {
+    // Whole pool is shared, but every pipeline needs one to move
+    if (!pxState->u8BufCountGiven)
+    {
+      u64Temp = ((uint64_t)ADT_DC_DEFAULT_BUF_COUNT) * u32Pipelines;
+      pxState->u32BufCount = ((u64Temp > ADT_DC_MAX_BUF_COUNT) ?
+			      ADT_DC_MAX_BUF_COUNT : (uint32_t)u64Temp);
+    }
+    if (pxState->u32BufCount < u32Pipelines)
+    {
+      return 0;
+    }
+    // Generation threads are per pipeline, share the processors
+    if (!pxState->u8GenThreadsGiven)
+    {
+      u64Temp = (((iCpus > 0) ? (uint64_t)iCpus : 1) / u32Pipelines);
+      pxState->u32GenThreads = ((u64Temp == 0) ? 1 :
+				((u64Temp > ADT_DC_MAX_DEFAULT_GEN_THREADS) ?
+				 ADT_DC_MAX_DEFAULT_GEN_THREADS : (uint32_t)u64Temp));
+    }
+  }
 
   return 1;
 }
 
 
 
-static void DC_PrepareBuffer(tDcState* pxState, void* pBufMem)
+// Device specific messages, prefixed when many devices run at once
+static void DC_Message(tDcState* pxState, const char* sFormat, ...)
 {
-  // Staticed here just for efficiency
-  static uint64_t u64BytesToWrite;
-  static uint64_t u64NumNumbers;
-  static uint64_t u64WriteNum;
-  static void* pMemUpperBound;
-  
-  memset(pBufMem, 0, pxState->u32BufSize);
-  // Pick smaller amount of full buffer and data left
-  u64BytesToWrite = pxState->u32BufSize;
-  u64NumNumbers = u64BytesToWrite / ADT_DC_RUNNING_NUM_SIZE_BYTES;
-  pMemUpperBound = pBufMem + (u64NumNumbers * ADT_DC_RUNNING_NUM_SIZE_BYTES);
-  u64WriteNum = pxState->u64CurrNumber;
+  va_list xArgs;
 
-  while (pBufMem < pMemUpperBound)
+  if (pxState->u8Multi)
   {
-    memcpy(pBufMem, &u64WriteNum, ADT_DC_RUNNING_NUM_SIZE_BYTES);
-    u64WriteNum++;
-    pBufMem += ADT_DC_RUNNING_NUM_SIZE_BYTES;
+    // Prefix goes after the newlines ending the progress lines
+    for (; sFormat[0] == '\n'; sFormat++)
+    {
+      printf("\n");
+    }
+    printf("%s: ", pxState->sDevice);
+    __atomic_add_fetch(&u32DcMessages, 1, __ATOMIC_RELAXED);
   }
-  pxState->u64CurrNumber += u64NumNumbers;
+  va_start(xArgs, sFormat);
+  vprintf(sFormat, xArgs);
+  va_end(xArgs);
 }
 
 
 
-static void DC_PrintProgress(tDcState* pxState, uint8_t u8ForcePrint)
+// Extents come in roughly in order, so mostly they just grow the
+// last one. Called from both the I/O and the verifier thread.
+static void DC_AddBadExtent(tDcState* pxState, uint64_t u64Begin,
+			    uint64_t u64End, uint8_t u8Kind)
 {
-  // Staticed here just for efficiency
-  static uint32_t u32TimeElapsed;
-  static uint32_t u32Secs;
-  static uint32_t u32Mins;
-  static uint32_t u32Hours;
-  static uint64_t u64PassedBytes;
-  static float fProgress;
-  static float fTimeElapsedFine;
-  static float fNowSpeedMbPerSeconds;
-  static float fAverageSpeedMbPerSeconds;
+  tDcExtent* pxLast = NULL;
+  tDcExtent* pxNew = NULL;
 
-  gettimeofday(&(pxState->xNowTime), NULL);
+  if (pxState->pxParent != NULL)
+  {
+    // Stripes gather to the device
+    pxState = pxState->pxParent;
+  }
+  pthread_mutex_lock(&(pxState->xExtentMutex));
 
-  // Preparations to ensure 5 seconds passed:
+  // Stream has all the compare failures as mismatches
+  pxState->au32ErrorCounts[((u8Kind > ADT_DC_EXTENT_MISMATCH) ? ADT_DC_EXTENT_MISMATCH : u8Kind)]++;
+
+  if (pxState->u32ExtentCount > 0)
+  {
+    pxLast = &(pxState->pxExtents[pxState->u32ExtentCount - 1]);
+  }
+  if ((pxLast != NULL) && (pxLast->u8Kind == u8Kind) &&
+      (u64Begin <= pxLast->u64End) && (u64End >= pxLast->u64Begin))
+  {
+    pxLast->u64Begin = ((u64Begin < pxLast->u64Begin) ? u64Begin : pxLast->u64Begin);
+    pxLast->u64End = ((u64End > pxLast->u64End) ? u64End : pxLast->u64End);
+  }
+  else
+  {
+    if (pxState->u32ExtentCount == pxState->u32ExtentCapacity)
+    {
+      pxNew = realloc(pxState->pxExtents,
+		      (pxState->u32ExtentCapacity + ADT_DC_EXTENT_ALLOC_STEP) * sizeof(tDcExtent));
+
+      if (pxNew == NULL)
+      {
+	// Keep what we have, better than nothing
+	pthread_mutex_unlock(&(pxState->xExtentMutex));
+
+	return;
+      }
+      pxState->pxExtents = pxNew;
+      pxState->u32ExtentCapacity += ADT_DC_EXTENT_ALLOC_STEP;
+    }
+    pxNew = &(pxState->pxExtents[pxState->u32ExtentCount]);
+    pxNew->u64Begin = u64Begin;
+    pxNew->u64End = u64End;
+    pxNew->u8Kind = u8Kind;
+    pxState->u32ExtentCount++;
+  }
+  pthread_mutex_unlock(&(pxState->xExtentMutex));
+}
+
+
+
+static int iDC_CompareExtents(const void* pA, const void* pB)
+{
+  const tDcExtent* pxA = (const tDcExtent*)pA;
+  const tDcExtent* pxB = (const tDcExtent*)pB;
+
+  if (pxA->u64Begin != pxB->u64Begin)
+  {
+    return ((pxA->u64Begin < pxB->u64Begin) ? -1 : 1);
+  }
+
+  return ((int)pxA->u8Kind - (int)pxB->u8Kind);
+}
+
+
+
+static void DC_ReportBadExtents(tDcState* pxState)
+{
+  static const char* asKinds[] = { "write error", "read error", "mismatch",
+				   "bad checksum", "misdirected", "stale" };
+  FILE* pxFile = NULL;
+  uint64_t u64Block = 0;
+  uint64_t u64NextBlock = 0;
+  uint32_t i;
+  char sSizeHumReadBuf[ADT_GEN_BUF_SIZE] = { 0 };
+
+  qsort(pxState->pxExtents, pxState->u32ExtentCount, sizeof(tDcExtent), iDC_CompareExtents);
+  printf("\nFound %u bad extents:\n", pxState->u32ExtentCount);
+
+  for (i = 0; i < pxState->u32ExtentCount; i++)
+  {
+    ADT_BytesToHumanReadable(pxState->pxExtents[i].u64End - pxState->pxExtents[i].u64Begin,
+			     sSizeHumReadBuf);
+    printf("%" PRIu64 "-%" PRIu64 " (%s) %s\n",
+	   pxState->pxExtents[i].u64Begin, pxState->pxExtents[i].u64End - 1,
+	   sSizeHumReadBuf, asKinds[pxState->pxExtents[i].u8Kind]);
+  }
+  if (pxState->u8MismatchSeen)
+  {
+    printf("First mismatch at byte %" PRIu64 " (%s), expected 0x%016" PRIx64 " but read 0x%016" PRIx64 "\n",
+	   pxState->u64BadOffset, asDcBadKinds[pxState->u8BadKind],
+	   pxState->u64BadExpected, pxState->u64BadActual);
+  }
+  if (pxState->sBadBlocksFile[0] == 0)
+  {
+    return;
+  }
+  // Same as badblocks -o, one block number per line, usable with e2fsck -l
+  pxFile = fopen(pxState->sBadBlocksFile, "w");
+
+  if (pxFile == NULL)
+  {
+    printf("Error: Unable to write bad blocks list to %s\n", pxState->sBadBlocksFile);
+
+    return;
+  }
+  for (i = 0; i < pxState->u32ExtentCount; i++)
+  {
+    u64Block = pxState->pxExtents[i].u64Begin / pxState->u32BadBlockSize;
+
+    // Sorted, so only overlap with the previous extent is possible
+    if (u64Block < u64NextBlock)
+    {
+      u64Block = u64NextBlock;
+    }
+    for (; u64Block <= ((pxState->pxExtents[i].u64End - 1) / pxState->u32BadBlockSize); u64Block++)
+    {
+      fprintf(pxFile, "%" PRIu64 "\n", u64Block);
+    }
+    u64NextBlock = u64Block;
+  }
+  fclose(pxFile);
+  printf("Bad blocks list (%u byte blocks) written to %s\n",
+	 pxState->u32BadBlockSize, pxState->sBadBlocksFile);
+}
+
+
+
+static uint64_t u64DC_NowNanos(void)
+{
+  struct timespec xTime;
+
+  clock_gettime(CLOCK_MONOTONIC, &xTime);
+
+  return (((uint64_t)xTime.tv_sec) * 1000000000) + xTime.tv_nsec;
+}
+
+
+
+static uint32_t u32DC_LatencyBucket(uint64_t u64Nanos)
+{
+  uint32_t u32Exp = 0;
+
+  if (u64Nanos < (1 << ADT_DC_LATENCY_SUB_BITS))
+  {
+    return (uint32_t)u64Nanos;
+  }
+  u32Exp = 63 - __builtin_clzll(u64Nanos);
+
+  return ((u32Exp - ADT_DC_LATENCY_SUB_BITS + 1) << ADT_DC_LATENCY_SUB_BITS) +
+    (uint32_t)((u64Nanos >> (u32Exp - ADT_DC_LATENCY_SUB_BITS)) & ((1 << ADT_DC_LATENCY_SUB_BITS) - 1));
+}
+
+
+
+// Highest value falling into the bucket
+static uint64_t u64DC_LatencyBucketTop(uint32_t u32Bucket)
+{
+  uint32_t u32Exp = (u32Bucket >> ADT_DC_LATENCY_SUB_BITS) + ADT_DC_LATENCY_SUB_BITS - 1;
+  uint64_t u64Sub = u32Bucket & ((1 << ADT_DC_LATENCY_SUB_BITS) - 1);
+
+  if (u32Bucket < (1 << ADT_DC_LATENCY_SUB_BITS))
+  {
+    return u32Bucket;
+  }
+
+  return ((((uint64_t)1 << ADT_DC_LATENCY_SUB_BITS) + u64Sub + 1) << (u32Exp - ADT_DC_LATENCY_SUB_BITS)) - 1;
+}
+
+
+
+static void DC_AtomicMin(uint64_t* pu64Value, uint64_t u64New)
+{
+  uint64_t u64Old = __atomic_load_n(pu64Value, __ATOMIC_RELAXED);
+
+  while ((u64New < u64Old) &&
+	 (!__atomic_compare_exchange_n(pu64Value, &u64Old, u64New,
+				       0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)))
+  {
+    ;
+  }
+}
+
+
+
+static void DC_AtomicMax(uint64_t* pu64Value, uint64_t u64New)
+{
+  uint64_t u64Old = __atomic_load_n(pu64Value, __ATOMIC_RELAXED);
+
+  while ((u64New > u64Old) &&
+	 (!__atomic_compare_exchange_n(pu64Value, &u64Old, u64New,
+				       0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)))
+  {
+    ;
+  }
+}
+
+
+
+// I/O goes to the zone it starts in, so zones should be
+// a good deal bigger than the I/Os for a smooth curve.
+static void DC_RecordZone(tDcState* pxState, uint64_t u64StartNanos, uint64_t u64EndNanos,
+			  uint64_t u64Offset, uint64_t u64Bytes, uint8_t u8Write)
+{
+  uint64_t u64Zone = u64Offset / pxState->u64ZoneBytes;
+  tDcZone* pxZone = NULL;
+
+  if (u64Zone >= pxState->u32Zones)
+  {
+    return;
+  }
+  pxZone = &(pxState->pxZones[(u8Write ? pxState->u32Zones : 0) + u64Zone]);
+  __atomic_add_fetch(&(pxZone->u64Bytes), u64Bytes, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&(pxZone->u64IoCount), 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&(pxZone->u64SumNanos), u64EndNanos - u64StartNanos, __ATOMIC_RELAXED);
+  DC_AtomicMin(&(pxZone->u64FirstStartNanos), u64StartNanos);
+  DC_AtomicMax(&(pxZone->u64LastEndNanos), u64EndNanos);
+  DC_AtomicMax(&(pxZone->u64MaxNanos), u64EndNanos - u64StartNanos);
+}
+
+
+
+static void DC_RecordLatency(tDcState* pxState, uint64_t u64StartNanos, uint64_t u64Offset,
+			     uint64_t u64Bytes, uint8_t u8Write)
+{
+  uint64_t u64EndNanos = u64DC_NowNanos();
+  uint64_t u64Nanos = u64EndNanos - u64StartNanos;
+  uint64_t u64Max = 0;
+  tDcLatency* pxLatency = NULL;
+  uint32_t u32Slot = 0;
+  uint32_t i;
+
+  if (pxState->pxParent != NULL)
+  {
+    // Stripes gather to the device
+    pxState = pxState->pxParent;
+  }
+  if (pxState->pxZones != NULL)
+  {
+    DC_RecordZone(pxState, u64StartNanos, u64EndNanos, u64Offset, u64Bytes, u8Write);
+  }
+  pxLatency = &(pxState->axLatency[u8Write ? 1 : 0]);
+  __atomic_add_fetch(&(pxLatency->au64Buckets[u32DC_LatencyBucket(u64Nanos)]), 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&(pxLatency->u64Count), 1, __ATOMIC_RELAXED);
+  DC_AtomicMax(&(pxLatency->u64MaxNanos), u64Nanos);
+  if (u64Nanos <= __atomic_load_n(&(pxLatency->u64WorstFloorNanos), __ATOMIC_RELAXED))
+  {
+    return;
+  }
+  pthread_mutex_lock(&(pxState->xLatencyMutex));
+
+  if (pxLatency->u32WorstCount < ADT_DC_LATENCY_WORST)
+  {
+    u32Slot = pxLatency->u32WorstCount++;
+    pxLatency->axWorst[u32Slot].u64Nanos = 0;
+  }
+  else
+  {
+    // Replace the fastest of the worst
+    for (i = 1; i < ADT_DC_LATENCY_WORST; i++)
+    {
+      if (pxLatency->axWorst[i].u64Nanos < pxLatency->axWorst[u32Slot].u64Nanos)
+      {
+	u32Slot = i;
+      }
+    }
+  }
+  if (u64Nanos > pxLatency->axWorst[u32Slot].u64Nanos)
+  {
+    pxLatency->axWorst[u32Slot].u64Nanos = u64Nanos;
+    pxLatency->axWorst[u32Slot].u64Offset = u64Offset;
+    pxLatency->axWorst[u32Slot].u64Bytes = u64Bytes;
+  }
+  if (pxLatency->u32WorstCount == ADT_DC_LATENCY_WORST)
+  {
+    // Only slower ones than the fastest listed need to come here now
+    u64Max = pxLatency->axWorst[0].u64Nanos;
+
+    for (i = 1; i < ADT_DC_LATENCY_WORST; i++)
+    {
+      u64Max = ((pxLatency->axWorst[i].u64Nanos < u64Max) ? pxLatency->axWorst[i].u64Nanos : u64Max);
+    }
+    __atomic_store_n(&(pxLatency->u64WorstFloorNanos), u64Max, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&(pxState->xLatencyMutex));
+}
+
+
+
+static uint64_t u64DC_LatencyPercentile(tDcLatency* pxLatency, uint32_t u32PerMille)
+{
+  uint64_t u64Wanted = (pxLatency->u64Count * u32PerMille + 999) / 1000;
+  uint64_t u64Seen = 0;
+  uint32_t i;
+
+  for (i = 0; i < ADT_DC_LATENCY_BUCKETS; i++)
+  {
+    u64Seen += pxLatency->au64Buckets[i];
+
+    if (u64Seen >= u64Wanted)
+    {
+      // Bucket top may overshoot the real maximum
+      return ((u64DC_LatencyBucketTop(i) < pxLatency->u64MaxNanos) ?
+	      u64DC_LatencyBucketTop(i) : pxLatency->u64MaxNanos);
+    }
+  }
+
+  return pxLatency->u64MaxNanos;
+}
+
+
+
+static int iDC_CompareSlowIos(const void* pA, const void* pB)
+{
+  const tDcSlowIo* pxA = (const tDcSlowIo*)pA;
+  const tDcSlowIo* pxB = (const tDcSlowIo*)pB;
+
+  if (pxA->u64Nanos != pxB->u64Nanos)
+  {
+    return ((pxA->u64Nanos > pxB->u64Nanos) ? -1 : 1);
+  }
+
+  return 0;
+}
+
+
+
+static void DC_ReportLatency(tDcState* pxState)
+{
+  static const char* asPhases[] = { "Read", "Write" };
+  tDcLatency* pxLatency = NULL;
+  uint32_t u32Phase;
+  uint32_t i;
+  char sSizeHumReadBuf[ADT_GEN_BUF_SIZE] = { 0 };
+
+  for (u32Phase = 2; u32Phase-- > 0; )
+  {
+    pxLatency = &(pxState->axLatency[u32Phase]);
+
+    if (pxLatency->u64Count == 0)
+    {
+      continue;
+    }
+    printf("\n%s latency of %" PRIu64 " I/Os: p50 %.3f ms  p99 %.3f ms  p99.9 %.3f ms  max %.3f ms\n",
+	   asPhases[u32Phase], pxLatency->u64Count,
+	   u64DC_LatencyPercentile(pxLatency, 500) / 1000000.0,
+	   u64DC_LatencyPercentile(pxLatency, 990) / 1000000.0,
+	   u64DC_LatencyPercentile(pxLatency, 999) / 1000000.0,
+	   pxLatency->u64MaxNanos / 1000000.0);
+    printf("Slowest:\n");
+    qsort(pxLatency->axWorst, pxLatency->u32WorstCount, sizeof(tDcSlowIo), iDC_CompareSlowIos);
+
+    for (i = 0; i < pxLatency->u32WorstCount; i++)
+    {
+      ADT_BytesToHumanReadable(pxLatency->axWorst[i].u64Bytes, sSizeHumReadBuf);
+      printf("%.3f ms at byte %" PRIu64 " (%s)\n", pxLatency->axWorst[i].u64Nanos / 1000000.0,
+	     pxLatency->axWorst[i].u64Offset, sSizeHumReadBuf);
+    }
+  }
+}
+
+
+
+static float fDC_ZoneSpeed(tDcZone* pxZone)
+{
+  if ((pxZone->u64IoCount == 0) || (pxZone->u64LastEndNanos <= pxZone->u64FirstStartNanos))
+  {
+    return 0.0;
+  }
+
+  return (1.0 * pxZone->u64Bytes) /
+    ((1.0 * ADT_BYTES_IN_MEBIBYTE) * ((pxZone->u64LastEndNanos - pxZone->u64FirstStartNanos) / 1000000000.0));
+}
+
+
+
+// Slow if below the given share of the mean of the neighbours
+// on both sides, zones without any I/O not counting.
+static uint8_t bDC_SlowZone(tDcState* pxState, tDcZone* pxZones, uint32_t u32Zone)
+{
+  float fSum = 0.0;
+  uint32_t u32Count = 0;
+  uint32_t i;
+
+  if (pxZones[u32Zone].u64IoCount == 0)
+  {
+    return 0;
+  }
+  for (i = ((u32Zone > ADT_DC_ZONE_NEIGHBOURS) ? (u32Zone - ADT_DC_ZONE_NEIGHBOURS) : 0);
+       (i <= (u32Zone + ADT_DC_ZONE_NEIGHBOURS)) && (i < pxState->u32Zones); i++)
+  {
+    if ((i != u32Zone) && (pxZones[i].u64IoCount > 0))
+    {
+      fSum += fDC_ZoneSpeed(&(pxZones[i]));
+      u32Count++;
+    }
+  }
+
+  return ((u32Count > 0) &&
+	  ((fDC_ZoneSpeed(&(pxZones[u32Zone])) * 100.0 * u32Count) <
+	   (fSum * pxState->u32SlowZonePercent)));
+}
+
+
+
+// Plain columns, loads directly to gnuplot and the like
+static void DC_WriteZoneMap(tDcState* pxState)
+{
+  static const char* asPhases[] = { "Read", "Write" };
+  FILE* pxFile = NULL;
+  tDcZone* pxZones = NULL;
+  uint32_t u32Phase;
+  uint32_t u32SlowCount = 0;
+  uint32_t i;
+
+  pxFile = fopen(pxState->sZoneFile, "w");
+
+  if (pxFile == NULL)
+  {
+    printf("Error: Unable to write zone map to %s\n", pxState->sZoneFile);
+
+    return;
+  }
+  fprintf(pxFile, "# diskcont zone map of %s, %" PRIu64 " bytes in %u zones, slow below %u%%\n",
+	  pxState->sDevice, pxState->u64DevSizeBytes, pxState->u32Zones,
+	  pxState->u32SlowZonePercent);
+  fprintf(pxFile, "# zone begin end write_mibps write_avg_ms write_max_ms write_slow "
+	  "read_mibps read_avg_ms read_max_ms read_slow\n");
+
+  for (i = 0; i < pxState->u32Zones; i++)
+  {
+    fprintf(pxFile, "%u %" PRIu64 " %" PRIu64, i, i * pxState->u64ZoneBytes,
+	    (((i + 1) == pxState->u32Zones) ? pxState->u64DevSizeBytes : ((i + 1) * pxState->u64ZoneBytes)));
+
+    for (u32Phase = 2; u32Phase-- > 0; )
+    {
+      pxZones = &(pxState->pxZones[u32Phase ? pxState->u32Zones : 0]);
+      fprintf(pxFile, " %.2f %.3f %.3f %u", fDC_ZoneSpeed(&(pxZones[i])),
+	      ((pxZones[i].u64IoCount > 0) ?
+	       (pxZones[i].u64SumNanos / (1000000.0 * pxZones[i].u64IoCount)) : 0.0),
+	      pxZones[i].u64MaxNanos / 1000000.0, bDC_SlowZone(pxState, pxZones, i));
+    }
+    fprintf(pxFile, "\n");
+  }
+  fclose(pxFile);
+  printf("\nZone map written to %s\n", pxState->sZoneFile);
+
+  for (u32Phase = 2; u32Phase-- > 0; )
+  {
+    pxZones = &(pxState->pxZones[u32Phase ? pxState->u32Zones : 0]);
+    u32SlowCount = 0;
+
+    for (i = 0; i < pxState->u32Zones; i++)
+    {
+      if (!bDC_SlowZone(pxState, pxZones, i))
+      {
+	continue;
+      }
+      if (u32SlowCount++ == 0)
+      {
+	printf("%s slow zones:\n", asPhases[u32Phase]);
+      }
+      printf("Zone %u at byte %" PRIu64 ": %.2f MiB/s\n", i, i * pxState->u64ZoneBytes,
+	     fDC_ZoneSpeed(&(pxZones[i])));
+    }
+  }
+}
+
+
+
+// Stripes start at aligned offsets, the last one takes the rest.
+// Returns the stripe size, number of stripes may get smaller.
+static uint64_t u64DC_StripeBytes(tDcState* pxState, uint32_t* pu32Stripes)
+{
+  uint64_t u64StripeBytes = (pxState->u64DevSizeBytes / pxState->u32Stripes) & ~(ADT_DC_STRIPE_ALIGN - 1);
+
+  *pu32Stripes = pxState->u32Stripes;
+
+  if (u64StripeBytes == 0)
+  {
+    u64StripeBytes = ADT_DC_STRIPE_ALIGN;
+    *pu32Stripes = (uint32_t)((pxState->u64DevSizeBytes + ADT_DC_STRIPE_ALIGN - 1) / ADT_DC_STRIPE_ALIGN);
+  }
+
+  return u64StripeBytes;
+}
+
+
+
+// Where the stripe starts, from the checkpoint if resuming that phase
+static uint64_t u64DC_StartOffset(tDcState* pxState, uint8_t u8Phase,
+				  uint32_t u32Stripe, uint64_t u64Default)
+{
+  if ((pxState->pu64ResumeOffsets != NULL) && (pxState->u8ResumePhase == u8Phase))
+  {
+    return pxState->pu64ResumeOffsets[u32Stripe];
+  }
+
+  return u64Default;
+}
+
+
+
+// Written to a temporary file first, so a crash in the middle
+// leaves the previous checkpoint in place.
+static void DC_SaveCheckpoint(tDcState* pxState, uint8_t u8Phase,
+			      const uint64_t* pu64Offsets, uint32_t u32Count)
+{
+  FILE* pxFile = NULL;
+  char sTempFile[ADT_GEN_BUF_SIZE + 8] = { 0 };
+  uint32_t i;
+
+  snprintf(sTempFile, sizeof(sTempFile), "%s.tmp", pxState->sStateFile);
+  pxFile = fopen(sTempFile, "w");
+
+  if (pxFile == NULL)
+  {
+    DC_Message(pxState, "Warning: Unable to write checkpoint %s\n", sTempFile);
+
+    return;
+  }
+  fprintf(pxFile, ADT_DC_CHECKPOINT_MAGIC "\n");
+  fprintf(pxFile, "serial=%s\n", pxState->sSerial);
+  fprintf(pxFile, "size=%" PRIu64 "\n", pxState->u64DevSizeBytes);
+  fprintf(pxFile, "phase=%s\n", ((u8Phase == ADT_DC_PHASE_WRITE) ? "write" : "read"));
+  fprintf(pxFile, "offsetkeyed=%u\n", pxState->u8OffsetKeyed);
+  fprintf(pxFile, "random=%u\n", pxState->u8Random);
+  fprintf(pxFile, "sectors=%u\n", pxState->u8Sectors);
+  fprintf(pxFile, "pass=%u\n", pxState->u32Pass);
+  fprintf(pxFile, "seed=0x%016" PRIx64 "\n", pxState->u64Seed);
+  fprintf(pxFile, "stripes=%u\n", u32Count);
+
+  for (i = 0; i < u32Count; i++)
+  {
+    fprintf(pxFile, "offset=%" PRIu64 "\n", pu64Offsets[i]);
+  }
+  fflush(pxFile);
+  fsync(fileno(pxFile));
+  fclose(pxFile);
+
+  if (rename(sTempFile, pxState->sStateFile) != 0)
+  {
+    DC_Message(pxState, "Warning: Unable to write checkpoint %s\n", pxState->sStateFile);
+  }
+}
+
+
+
+// Checkpoint at the start of a phase, every stripe at its beginning
+static void DC_SavePhaseStart(tDcState* pxState, uint8_t u8Phase)
+{
+  uint64_t au64Offsets[ADT_DC_MAX_STRIPES];
+  uint64_t u64StripeBytes = 0;
+  uint32_t u32Stripes = 1;
+  uint32_t i;
+
+  if (pxState->sStateFile[0] == 0)
+  {
+    return;
+  }
+  u64StripeBytes = u64DC_StripeBytes(pxState, &u32Stripes);
+
+  for (i = 0; (i < u32Stripes) && (i < ADT_DC_MAX_STRIPES); i++)
+  {
+    au64Offsets[i] = ((u32Stripes > 1) ? (i * u64StripeBytes) : 0);
+  }
+  DC_SaveCheckpoint(pxState, u8Phase, au64Offsets, i);
+}
+
+
+
+// Device must be the one checkpointed. Pattern key comes from the
+// file, everything else must match what was given now.
+static uint8_t bDC_LoadCheckpoint(tDcState* pxState)
+{
+  FILE* pxFile = fopen(pxState->sStateFile, "r");
+  char sLine[ADT_GEN_BUF_SIZE] = { 0 };
+  char sValue[ADT_GEN_BUF_SIZE] = { 0 };
+  uint64_t u64Value = 0;
+  uint32_t u32Offsets = 0;
+  uint32_t u32Stripes = 0;
+  uint32_t u32ExpectedStripes = 0;
+  uint8_t u8Ok = 1;
+
+  if (pxFile == NULL)
+  {
+    printf("Error: Unable to read checkpoint %s\n", pxState->sStateFile);
+
+    return 0;
+  }
+  if ((fgets(sLine, sizeof(sLine), pxFile) == NULL) ||
+      (strncmp(sLine, ADT_DC_CHECKPOINT_MAGIC, strlen(ADT_DC_CHECKPOINT_MAGIC)) != 0))
+  {
+    printf("Error: %s is not a diskcont checkpoint\n", pxState->sStateFile);
+    fclose(pxFile);
+
+    return 0;
+  }
+  pxState->u8ResumePhase = ADT_DC_PHASE_IDLE;
+
+  while (u8Ok && (fgets(sLine, sizeof(sLine), pxFile) != NULL))
+  {
+    sLine[strcspn(sLine, "\n")] = 0;
+
+    if (strncmp(sLine, "serial=", strlen("serial=")) == 0)
+    {
+      u8Ok = (strcmp(sLine + strlen("serial="), pxState->sSerial) == 0);
+    }
+    else if (sscanf(sLine, "size=%" SCNu64, &u64Value) == 1)
+    {
+      u8Ok = (u64Value == pxState->u64DevSizeBytes);
+    }
+    else if (sscanf(sLine, "phase=%s", sValue) == 1)
+    {
+      pxState->u8ResumePhase = ((strcmp(sValue, "write") == 0) ? ADT_DC_PHASE_WRITE :
+				((strcmp(sValue, "read") == 0) ? ADT_DC_PHASE_READ :
+				 ADT_DC_PHASE_IDLE));
+    }
+    else if (sscanf(sLine, "offsetkeyed=%" SCNu64, &u64Value) == 1)
+    {
+      pxState->u8OffsetKeyed = (u64Value ? 1 : 0);
+    }
+    else if (sscanf(sLine, "random=%" SCNu64, &u64Value) == 1)
+    {
+      pxState->u8Random = (u64Value ? 1 : 0);
+    }
+    else if (sscanf(sLine, "sectors=%" SCNu64, &u64Value) == 1)
+    {
+      pxState->u8Sectors = (u64Value ? 1 : 0);
+    }
+    else if (sscanf(sLine, "pass=%" SCNu64, &u64Value) == 1)
+    {
+      pxState->u32Pass = (uint32_t)u64Value;
+    }
+    else if (sscanf(sLine, "seed=%" SCNx64, &u64Value) == 1)
+    {
+      pxState->u64Seed = u64Value;
+    }
+    else if ((sscanf(sLine, "stripes=%" SCNu64, &u64Value) == 1) &&
+	     (pxState->pu64ResumeOffsets == NULL) &&
+	     (u64Value > 0) && (u64Value <= ADT_DC_MAX_STRIPES))
+    {
+      u32Stripes = (uint32_t)u64Value;
+      pxState->pu64ResumeOffsets = calloc(u32Stripes, sizeof(uint64_t));
+      u8Ok = (pxState->pu64ResumeOffsets != NULL);
+    }
+    else if ((sscanf(sLine, "offset=%" SCNu64, &u64Value) == 1) &&
+	     (u32Offsets < u32Stripes) && (u64Value <= pxState->u64DevSizeBytes))
+    {
+      pxState->pu64ResumeOffsets[u32Offsets] = u64Value;
+      u32Offsets++;
+    }
+    else
+    {
+      u8Ok = 0;
+    }
+  }
+  fclose(pxFile);
+  u64DC_StripeBytes(pxState, &u32ExpectedStripes);
+
+  if ((!u8Ok) || (pxState->u8ResumePhase == ADT_DC_PHASE_IDLE) ||
+      (u32Stripes != u32ExpectedStripes) || (u32Offsets != u32Stripes))
+  {
+    printf("Error: Checkpoint %s does not match device %s (or -p)\n",
+	   pxState->sStateFile, pxState->sDevice);
+    free(pxState->pu64ResumeOffsets);
+    pxState->pu64ResumeOffsets = NULL;
+
+    return 0;
+  }
+
+  return 1;
+}
+
+
+
+// Called regularly from the I/O loop of each pipeline. Written data
+// is synced before it counts as durable. Stripes only publish their
+// offset, the device saves them all.
+static void DC_Checkpoint(tDcState* pxState, uint64_t u64DoneOffset)
+{
+  struct timeval xNowTime;
+
+  if (pxState->sStateFile[0] == 0)
+  {
+    return;
+  }
+  gettimeofday(&xNowTime, NULL);
+
+  if (xNowTime.tv_sec < (pxState->xCheckpointTime.tv_sec + ADT_DC_CHECKPOINT_INTERVAL))
+  {
+    return;
+  }
+  pxState->xCheckpointTime = xNowTime;
+
+  if (pxState->u8PipelineWrite && (fsync(pxState->iFd) != 0))
+  {
+    return;
+  }
+  __atomic_store_n(&(pxState->u64DurableOffset), u64DoneOffset, __ATOMIC_RELEASE);
+
+  if (pxState->pxParent == NULL)
+  {
+    DC_SaveCheckpoint(pxState, (pxState->u8PipelineWrite ? ADT_DC_PHASE_WRITE : ADT_DC_PHASE_READ),
+		      &(pxState->u64DurableOffset), 1);
+  }
+}
+
+
+
+static void DC_RunSlice(tDcState* pxState, tDcGenWorker* pxWorker)
+{
+  uint64_t u64SliceBytes = 0;
+  uint64_t u64SliceBegin = 0;
+  uint64_t u64SliceEnd = 0;
+  uint64_t u64BadOffset = 0;
+
+  // Slices are whole pages, so threads never share cache lines
+  u64SliceBytes = (pxState->u64GenBytes + pxState->u32GenSlices - 1) / pxState->u32GenSlices;
+  u64SliceBytes = ((u64SliceBytes + ADT_DC_GEN_SLICE_ALIGN - 1) / ADT_DC_GEN_SLICE_ALIGN) *
+    ADT_DC_GEN_SLICE_ALIGN;
+  u64SliceBegin = u64SliceBytes * pxWorker->u32Slice;
+  u64SliceEnd = u64SliceBegin + u64SliceBytes;
+  pxWorker->u64BadOffset = pxState->u64GenBytes;
+
+  if (u64SliceEnd > pxState->u64GenBytes)
+  {
+    // Last slice takes also the possible odd tail bytes
+    u64SliceEnd = pxState->u64GenBytes;
+  }
+  if (u64SliceBegin >= u64SliceEnd)
+  {
+    return;
+  }
+  // Pattern kernels are reentrant, any thread can do any part of
+  // any buffer as long as it knows the starting running number.
+  if (pxState->u8GenJob == ADT_DC_GEN_JOB_FILL)
+  {
+    ADT_PatternFill(pxState->pGenMem + u64SliceBegin, u64SliceEnd - u64SliceBegin,
+		    pxState->u64GenNumber + (u64SliceBegin / ADT_DC_RUNNING_NUM_SIZE_BYTES));
+  }
+  else
+  {
+    u64BadOffset = u64ADT_PatternVerify(pxState->pGenMem + u64SliceBegin,
+					u64SliceEnd - u64SliceBegin,
+					pxState->u64GenNumber +
+					(u64SliceBegin / ADT_DC_RUNNING_NUM_SIZE_BYTES),
+					&(pxWorker->u64Expected), &(pxWorker->u64Actual),
+					&(pxWorker->u8Kind));
+
+    if (u64BadOffset < (u64SliceEnd - u64SliceBegin))
+    {
+      pxWorker->u64BadOffset = u64SliceBegin + u64BadOffset;
+    }
+  }
+}
+
+
+
+static void* pDC_GenWorker(void* pParams)
+{
+  tDcGenWorker* pxWorker = (tDcGenWorker*)pParams;
+  tDcState* pxState = pxWorker->pxState;
+
+  while (1)
+  {
+    while (sem_wait(&(pxWorker->xSemStart)) != 0)
+    {
+      // Interrupted, try again
+    }
+    if (pxState->u8GenExit)
+    {
+      break;
+    }
+    DC_RunSlice(pxState, pxWorker);
+    sem_post(&(pxState->xSemGenDone));
+  }
+
+  return NULL;
+}
+
+
+
+static void DC_StopGenWorkers(tDcState* pxState)
+{
+  uint32_t i;
+
+  if (pxState->pxGenWorkers == NULL)
+  {
+    return;
+  }
+  pxState->u8GenExit = 1;
+
+  for (i = 1; i < pxState->u32GenSlices; i++)
+  {
+    sem_post(&(pxState->pxGenWorkers[i].xSemStart));
+    pthread_join(pxState->pxGenWorkers[i].xThread, NULL);
+    sem_destroy(&(pxState->pxGenWorkers[i].xSemStart));
+  }
+  sem_destroy(&(pxState->xSemGenDone));
+  free(pxState->pxGenWorkers);
+  pxState->pxGenWorkers = NULL;
+  pxState->u32GenSlices = 1;
+}
+
+
+
+// Slice 0 is always done by the calling thread itself,
+// so only the rest of the slices need threads. Never fails,
+// with fewer workers the slices are just bigger, down to the
+// calling thread doing all of it alone.
+static void DC_StartGenWorkers(tDcState* pxState)
+{
+  uint32_t i;
+
+  pxState->u8GenExit = 0;
+  pxState->u32GenSlices = 1;
+  pxState->pxGenWorkers = calloc(pxState->u32GenThreads, sizeof(tDcGenWorker));
+
+  if (pxState->pxGenWorkers != NULL)
+  {
+    pxState->pxGenWorkers[0].pxState = pxState;
+    pxState->pxGenWorkers[0].u32Slice = 0;
+
+    if (sem_init(&(pxState->xSemGenDone), 0, 0) != 0)
+    {
+      free(pxState->pxGenWorkers);
+      pxState->pxGenWorkers = NULL;
+    }
+  }
+  for (i = 1; (pxState->pxGenWorkers != NULL) && (i < pxState->u32GenThreads); i++)
+  {
+    pxState->pxGenWorkers[i].pxState = pxState;
+    pxState->pxGenWorkers[i].u32Slice = i;
+
+    if (sem_init(&(pxState->pxGenWorkers[i].xSemStart), 0, 0) != 0)
+    {
+      break;
+    }
+    if (pthread_create(&(pxState->pxGenWorkers[i].xThread), NULL,
+		       pDC_GenWorker, &(pxState->pxGenWorkers[i])) != 0)
+    {
+      sem_destroy(&(pxState->pxGenWorkers[i].xSemStart));
+
+      break;
+    }
+    pxState->u32GenSlices++;
+  }
+  if (pxState->u32GenSlices < pxState->u32GenThreads)
+  {
+    DC_Message(pxState, "Warning: Unable to start all generation workers, using %u threads\n",
+	       pxState->u32GenSlices);
+  }
+}
+
+
+
+// Runs one fill or verify over the whole buffer, in slices over the pool.
+// Returns the first bad offset in the buffer, u64Bytes if all good.
+static uint64_t u64DC_RunGenJob(tDcState* pxState, uint8_t u8Job, void* pBufMem,
+				uint64_t u64Bytes, uint64_t u64StartNumber)
+{
+  tDcGenWorker xSelf;
+  tDcGenWorker* pxSelf = ((pxState->pxGenWorkers != NULL) ? &(pxState->pxGenWorkers[0]) : &xSelf);
+  uint64_t u64BadOffset = u64Bytes;
+  uint32_t i;
+
+  xSelf.pxState = pxState;
+  xSelf.u32Slice = 0;
+  pxState->u8GenJob = u8Job;
+  pxState->pGenMem = pBufMem;
+  pxState->u64GenBytes = u64Bytes;
+  pxState->u64GenNumber = u64StartNumber;
+
+  // Semaphores publish the job to the workers
+  for (i = 1; i < pxState->u32GenSlices; i++)
+  {
+    sem_post(&(pxState->pxGenWorkers[i].xSemStart));
+  }
+  DC_RunSlice(pxState, pxSelf);
+
+  for (i = 1; i < pxState->u32GenSlices; i++)
+  {
+    while (sem_wait(&(pxState->xSemGenDone)) != 0)
+    {
+      // Interrupted, try again
+    }
+  }
+  if (u8Job == ADT_DC_GEN_JOB_VERIFY)
+  {
+    // Slices are in buffer order, first bad one is the one
+    for (i = 0; i < pxState->u32GenSlices; i++)
+    {
+      pxSelf = ((pxState->pxGenWorkers != NULL) ? &(pxState->pxGenWorkers[i]) : &xSelf);
+
+      if (pxSelf->u64BadOffset < u64Bytes)
+      {
+	u64BadOffset = pxSelf->u64BadOffset;
+	pxState->u8GenBadKind = pxSelf->u8Kind;
+
+	if (!pxState->u8MismatchSeen)
+	{
+	  pxState->u64BadExpected = pxSelf->u64Expected;
+	  pxState->u64BadActual = pxSelf->u64Actual;
+	  pxState->u8BadKind = pxSelf->u8Kind;
+	}
+
+	break;
+      }
+    }
+  }
+
+  return u64BadOffset;
+}
+
+
+
+static void DC_PrepareBuffer(tDcState* pxState, tDcBuffer* pxBuf)
+{
+  u64DC_RunGenJob(pxState, ADT_DC_GEN_JOB_FILL, pxBuf->pMem, pxBuf->u64Bytes,
+		  pxBuf->u64Offset / ADT_DC_RUNNING_NUM_SIZE_BYTES);
+}
+
+
+
+static uint8_t bDC_CheckBuffer(tDcState* pxState, tDcBuffer* pxBuf)
+{
+  uint64_t u64Pos = 0;
+  uint64_t u64BadOffset = 0;
+  uint64_t u64SectorBegin = 0;
+  uint64_t u64SectorEnd = 0;
+  uint64_t u64Limit = 0;
+  uint64_t u64Unit = pxState->u32BlockSize;
+  uint32_t u32Skip = 0;
+
+  if (pxState->u8Sectors && (u64Unit < ADT_PATTERN_SECTOR_SIZE))
+  {
+    // Headered sectors are good or bad as a whole
+    u64Unit = ADT_PATTERN_SECTOR_SIZE;
+  }
+  while (u64Pos < pxBuf->u64Bytes)
+  {
+    // Verify up to the next range the reader already recorded
+    u64Limit = ((u32Skip < pxBuf->u32SkipCount) ?
+		(pxBuf->pxSkips[u32Skip].u64Begin - pxBuf->u64Offset) : pxBuf->u64Bytes);
+    u64BadOffset = u64Limit;
+
+    if (u64Pos < u64Limit)
+    {
+      u64BadOffset = u64Pos + u64DC_RunGenJob(pxState, ADT_DC_GEN_JOB_VERIFY, pxBuf->pMem + u64Pos,
+					      u64Limit - u64Pos,
+					      (pxBuf->u64Offset + u64Pos) / ADT_DC_RUNNING_NUM_SIZE_BYTES);
+    }
+    if (u64BadOffset >= u64Limit)
+    {
+      if (u32Skip == pxBuf->u32SkipCount)
+      {
+	break;
+      }
+      u64Limit = pxBuf->pxSkips[u32Skip].u64End - pxBuf->u64Offset;
+      u64Pos = ((u64Limit > u64Pos) ? u64Limit : u64Pos);
+      u32Skip++;
+
+      continue;
+    }
+    u64BadOffset += pxBuf->u64Offset;
+
+    if (!pxState->u8MismatchSeen)
+    {
+      pxState->u8MismatchSeen = 1;
+      pxState->u64BadOffset = u64BadOffset;
+    }
+    if (!pxState->u8Continue)
+    {
+      return 0;
+    }
+    // Record the whole logical block and go on after it
+    u64SectorBegin = u64BadOffset - (u64BadOffset % u64Unit);
+    u64SectorBegin = ((u64SectorBegin < pxBuf->u64Offset) ? pxBuf->u64Offset : u64SectorBegin);
+    u64SectorEnd = u64BadOffset - (u64BadOffset % u64Unit) + u64Unit;
+    u64SectorEnd = ((u64SectorEnd > (pxBuf->u64Offset + u64Limit)) ?
+		    (pxBuf->u64Offset + u64Limit) : u64SectorEnd);
+    DC_AddBadExtent(pxState, u64SectorBegin, u64SectorEnd,
+		    ADT_DC_EXTENT_MISMATCH + pxState->u8GenBadKind);
+    u64Pos = u64SectorEnd - pxBuf->u64Offset;
+  }
+
+  return 1;
+}
+
+
+
+static void DC_PrintProgress(tDcState* pxState, uint8_t u8ForcePrint)
+{
+  // Staticed here just for efficiency
+  static uint32_t u32TimeElapsed;
+  static uint32_t u32Secs;
+  static uint32_t u32Mins;
+  static uint32_t u32Hours;
+  static uint64_t u64PassedBytes;
+  static float fProgress;
+  static float fTimeElapsedFine;
+  static float fNowSpeedMbPerSeconds;
+  static float fAverageSpeedMbPerSeconds;
+
+  if (pxState->u8Multi)
+  {
+    // Main thread shows all devices together
+    return;
+  }
+  gettimeofday(&(pxState->xNowTime), NULL);
+
+  // Preparations to ensure 5 seconds passed:
   pxState->xNowTime.tv_sec -= 5;
   
-  // Do something only if eligible
-  if (u8ForcePrint || timercmp(&(pxState->xLastTime), &(pxState->xNowTime), <))
+  // Do something only if eligible
+  if (u8ForcePrint || timercmp(&(pxState->xLastTime), &(pxState->xNowTime), <))
+  {
+    // Fix the 5 seconds stuff
+    pxState->xNowTime.tv_sec += 5;
+
+    // Calculate needed variables
+    u32TimeElapsed = pxState->xNowTime.tv_sec - pxState->xStartTime.tv_sec;
+    u32Secs = u32TimeElapsed % 60;
+    u32TimeElapsed -= u32Secs;
+    u32Mins = (u32TimeElapsed % 3600) / 60;
+    u32TimeElapsed -= u32Mins * 60;
+    u32Hours = u32TimeElapsed / 3600;
+    u64PassedBytes = pxState->u64TotalBytes - pxState->u64NowDataLeftBytes;
+    fProgress = 100.0 * (1.0 * u64PassedBytes) / (1.0 * pxState->u64TotalBytes);
+    
+    fNowSpeedMbPerSeconds = 0.0;
+    fAverageSpeedMbPerSeconds = 0.0;
+    
+    // First calculate current speed
+    fTimeElapsedFine = (1.0 * (pxState->xNowTime.tv_sec - pxState->xLastTime.tv_sec)) +
+      (0.000001 * (pxState->xNowTime.tv_usec - pxState->xLastTime.tv_usec));
+    fNowSpeedMbPerSeconds = (1.0 * (pxState->u64LastDataLeftBytes - pxState->u64NowDataLeftBytes)) /
+      ((1.0 * ADT_BYTES_IN_MEBIBYTE) * fTimeElapsedFine);
+    // And now we calculate average speed
+    fTimeElapsedFine = (1.0 * (pxState->xNowTime.tv_sec - pxState->xStartTime.tv_sec)) +
+      (0.000001 * (pxState->xNowTime.tv_usec - pxState->xStartTime.tv_usec));
+    fAverageSpeedMbPerSeconds = (1.0 * (pxState->u64StartDataLeftBytes - pxState->u64NowDataLeftBytes)) /
+      ((1.0 * ADT_BYTES_IN_MEBIBYTE) * fTimeElapsedFine);
+
+    printf("\x1b[A" "\x1b[A" "\r%" PRIu64 "/%" PRIu64 " bytes, %02.2f%% done. \n"
+	   "%uh %02um %02us elapsed. \n"
+	   "Speed now: %.2f MiB/s  Average: %.2f MiB/s  Bad extents: %u       ",
+	   u64PassedBytes, pxState->u64TotalBytes, fProgress,
+	   u32Hours, u32Mins, u32Secs, fNowSpeedMbPerSeconds, fAverageSpeedMbPerSeconds,
+	   pxState->u32ExtentCount);
+    fflush(stdout);
+
+    // Now that this has been resolved, make current accounting values old values
+    pxState->xLastTime = pxState->xNowTime;
+    pxState->u64LastDataLeftBytes = pxState->u64NowDataLeftBytes;
+  }
+}
+
+
+
+
+// Direct I/O needs the memory aligned to at least the logical
+// block size, mappings are page aligned which covers all sane devices.
+static uint8_t bDC_AllocBuffer(tDcState* pxState, tDcBuffer* pxBuf)
+{
+  static uint8_t u8Shown = 0;
+  char sDescription[ADT_GEN_BUF_SIZE] = { 0 };
+
+  pxBuf->pxSkips = NULL;
+  pxBuf->u32SkipCount = 0;
+  pxBuf->u32SkipCapacity = 0;
+
+  if (!bADT_MemAlloc(&(pxBuf->xMem), pxState->u32BufSize, pxState->iNumaNode))
+  {
+    pxBuf->pMem = NULL;
+
+    return 0;
+  }
+  pxBuf->pMem = pxBuf->xMem.pMem;
+
+  if (!__atomic_exchange_n(&u8Shown, 1, __ATOMIC_RELAXED))
+  {
+    // All get the same kind, first one tells enough
+    ADT_MemDescribe(pxBuf->xMem.u8Flags, sDescription);
+    DC_Message(pxState, "Buffers on %s\n", sDescription);
+  }
+
+  return 1;
+}
+
+
+
+static void DC_FreeBuffer(tDcBuffer* pxBuf)
+{
+  ADT_MemFree(&(pxBuf->xMem));
+  pxBuf->pMem = NULL;
+  free(pxBuf->pxSkips);
+  pxBuf->pxSkips = NULL;
+  pxBuf->u32SkipCount = 0;
+  pxBuf->u32SkipCapacity = 0;
+}
+
+
+
+// Narrowing goes in order, so mostly this just grows the last one
+static void DC_AddBufferSkip(tDcBuffer* pxBuf, uint64_t u64Begin, uint64_t u64End)
+{
+  tDcExtent* pxNew = NULL;
+
+  if ((pxBuf->u32SkipCount > 0) &&
+      (pxBuf->pxSkips[pxBuf->u32SkipCount - 1].u64End == u64Begin))
+  {
+    pxBuf->pxSkips[pxBuf->u32SkipCount - 1].u64End = u64End;
+
+    return;
+  }
+  if (pxBuf->u32SkipCount == pxBuf->u32SkipCapacity)
+  {
+    pxNew = realloc(pxBuf->pxSkips,
+		    (pxBuf->u32SkipCapacity + ADT_DC_EXTENT_ALLOC_STEP) * sizeof(tDcExtent));
+
+    if (pxNew == NULL)
+    {
+      // Verifier reports it once more as a mismatch, no worse
+      return;
+    }
+    pxBuf->pxSkips = pxNew;
+    pxBuf->u32SkipCapacity += ADT_DC_EXTENT_ALLOC_STEP;
+  }
+  pxBuf->pxSkips[pxBuf->u32SkipCount].u64Begin = u64Begin;
+  pxBuf->pxSkips[pxBuf->u32SkipCount].u64End = u64End;
+  pxBuf->pxSkips[pxBuf->u32SkipCount].u8Kind = ADT_DC_EXTENT_READ_ERROR;
+  pxBuf->u32SkipCount++;
+}
+
+
+
+static int iDC_OpenDevice(tDcState* pxState, int iFlags)
+{
+  if (pxState->u8Direct)
+  {
+    iFlags |= O_DIRECT;
+  }
+  pxState->iFd = open(pxState->sDevice, iFlags);
+
+  if ((pxState->iFd != -1) && (!pxState->u8Direct))
+  {
+    // Bigger readahead, and pages behind us go first
+    posix_fadvise(pxState->iFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
+  if ((pxState->iFd != -1) && pxState->u8Uring && (pxState->pi32UringResults == NULL))
+  {
+    pxState->pi32UringResults = malloc(pxState->u32QueueDepth * sizeof(int32_t));
+    pxState->pu64UringStartNanos = malloc(pxState->u32QueueDepth * sizeof(uint64_t));
+
+    if ((pxState->pi32UringResults == NULL) || (pxState->pu64UringStartNanos == NULL) ||
+	(!bADT_UringInit(&(pxState->xUring), pxState->u32QueueDepth)))
+    {
+      DC_Message(pxState, "Warning: io_uring not available, using synchronous I/O\n");
+      free(pxState->pi32UringResults);
+      free(pxState->pu64UringStartNanos);
+      pxState->pi32UringResults = NULL;
+      pxState->pu64UringStartNanos = NULL;
+      pxState->u8Uring = 0;
+    }
+  }
+
+  return pxState->iFd;
+}
+
+
+
+static void DC_CloseDevice(tDcState* pxState)
+{
+  if (pxState->pi32UringResults != NULL)
+  {
+    ADT_UringExit(&(pxState->xUring));
+    free(pxState->pi32UringResults);
+    free(pxState->pu64UringStartNanos);
+    pxState->pi32UringResults = NULL;
+    pxState->pu64UringStartNanos = NULL;
+  }
+  close(pxState->iFd);
+  pxState->iFd = -1;
+}
+
+
+
+// Keeps u32QueueDepth requests of u32IoSize in flight. Completions
+// are accounted in order, so the return value is always the amount
+// of bytes continuously done from the beginning of the buffer.
+static uint64_t u64DC_TransferUring(tDcState* pxState, void* pBufMem,
+				    uint64_t u64Offset, uint64_t u64Bytes,
+				    uint8_t u8Write)
+{
+  uint64_t u64NumChunks = (u64Bytes + pxState->u32IoSize - 1) / pxState->u32IoSize;
+  uint64_t u64NextChunk = 0;
+  uint64_t u64LowChunk = 0;
+  uint64_t u64DoneBytes = 0;
+  uint64_t u64UserData = 0;
+  uint64_t u64ChunkBytes = 0;
+  uint32_t u32InFlight = 0;
+  int32_t i32Result = 0;
+  uint8_t u8Failed = 0;
+
+  while ((u32InFlight > 0) || ((!u8Failed) && (u64LowChunk < u64NumChunks)))
+  {
+    // Top up the queue. Window is limited so that result slots
+    // of unaccounted chunks never get reused.
+    while ((!u8Failed) && (u64NextChunk < u64NumChunks) &&
+	   ((u64NextChunk - u64LowChunk) < pxState->u32QueueDepth))
+    {
+      u64ChunkBytes = u64Bytes - (u64NextChunk * pxState->u32IoSize);
+      u64ChunkBytes = ((u64ChunkBytes > pxState->u32IoSize) ? pxState->u32IoSize : u64ChunkBytes);
+
+      if (!bADT_UringQueueRw(&(pxState->xUring), pxState->iFd,
+			     pBufMem + (u64NextChunk * pxState->u32IoSize),
+			     (uint32_t)u64ChunkBytes,
+			     u64Offset + (u64NextChunk * pxState->u32IoSize),
+			     u8Write, u64NextChunk))
+      {
+	break;
+      }
+      pxState->pi32UringResults[u64NextChunk % pxState->u32QueueDepth] = ADT_DC_URING_PENDING;
+      pxState->pu64UringStartNanos[u64NextChunk % pxState->u32QueueDepth] = u64DC_NowNanos();
+      u64NextChunk++;
+      u32InFlight++;
+    }
+    if (iADT_UringSubmit(&(pxState->xUring), 1) < 0)
+    {
+      // Ring itself broken, but buffers are still the kernel's
+      // until whatever it took has completed
+      ADT_UringDrain(&(pxState->xUring), u32InFlight);
+
+      return u64DoneBytes;
+    }
+    while (bADT_UringReap(&(pxState->xUring), &u64UserData, &i32Result))
+    {
+      pxState->pi32UringResults[u64UserData % pxState->u32QueueDepth] = i32Result;
+      u32InFlight--;
+      u64ChunkBytes = u64Bytes - (u64UserData * pxState->u32IoSize);
+      DC_RecordLatency(pxState, pxState->pu64UringStartNanos[u64UserData % pxState->u32QueueDepth],
+		       u64Offset + (u64UserData * pxState->u32IoSize),
+		       ((u64ChunkBytes > pxState->u32IoSize) ? pxState->u32IoSize : u64ChunkBytes),
+		       u8Write);
+    }
+    // Account completions in order
+    while ((!u8Failed) && (u64LowChunk < u64NextChunk) &&
+	   (pxState->pi32UringResults[u64LowChunk % pxState->u32QueueDepth] != ADT_DC_URING_PENDING))
+    {
+      u64ChunkBytes = u64Bytes - (u64LowChunk * pxState->u32IoSize);
+      u64ChunkBytes = ((u64ChunkBytes > pxState->u32IoSize) ? pxState->u32IoSize : u64ChunkBytes);
+      i32Result = pxState->pi32UringResults[u64LowChunk % pxState->u32QueueDepth];
+
+      if (i32Result != u64ChunkBytes)
+      {
+	// Short or failed, let the rest drain and report up to here
+	u8Failed = 1;
+	u64DoneBytes += ((i32Result > 0) ? i32Result : 0);
+
+	break;
+      }
+      u64DoneBytes += u64ChunkBytes;
+      u64LowChunk++;
+    }
+  }
+
+  return u64DoneBytes;
+}
+
+
+
+static uint64_t u64DC_Transfer(tDcState* pxState, void* pBufMem, uint64_t u64Offset,
+			       uint64_t u64Bytes, uint8_t u8Write)
+{
+  uint64_t u64AlignedBytes = u64Bytes;
+  uint64_t u64DoneBytes = 0;
+  ssize_t iCallBytes = 0;
+  uint64_t u64StartNanos = 0;
+  int iFlags = 0;
+
+  if (pxState->u8Direct)
+  {
+    u64AlignedBytes -= (u64Bytes % pxState->u32BlockSize);
+  }
+  if (u64AlignedBytes)
+  {
+    if (pxState->u8Uring)
+    {
+      u64DoneBytes = u64DC_TransferUring(pxState, pBufMem, u64Offset,
+					 u64AlignedBytes, u8Write);
+    }
+    else
+    {
+      u64StartNanos = u64DC_NowNanos();
+      iCallBytes = (u8Write ?
+		    pwrite(pxState->iFd, pBufMem, u64AlignedBytes, u64Offset) :
+		    pread(pxState->iFd, pBufMem, u64AlignedBytes, u64Offset));
+      DC_RecordLatency(pxState, u64StartNanos, u64Offset, u64AlignedBytes, u8Write);
+      u64DoneBytes = ((iCallBytes > 0) ? iCallBytes : 0);
+    }
+    if (u64DoneBytes != u64AlignedBytes)
+    {
+      return u64DoneBytes;
+    }
+  }
+  if (u64DoneBytes < u64Bytes)
+  {
+    // Unaligned tail cannot go through O_DIRECT, so drop the flag
+    // for the rest of the bytes. Happens only at the very end.
+    iFlags = fcntl(pxState->iFd, F_GETFL);
+
+    if ((iFlags == -1) ||
+	(fcntl(pxState->iFd, F_SETFL, (iFlags & ~O_DIRECT)) == -1))
+    {
+      return u64DoneBytes;
+    }
+    u64StartNanos = u64DC_NowNanos();
+    iCallBytes = (u8Write ?
+		  pwrite(pxState->iFd, pBufMem + u64DoneBytes,
+			 u64Bytes - u64DoneBytes, u64Offset + u64DoneBytes) :
+		  pread(pxState->iFd, pBufMem + u64DoneBytes,
+			u64Bytes - u64DoneBytes, u64Offset + u64DoneBytes));
+    DC_RecordLatency(pxState, u64StartNanos, u64Offset + u64DoneBytes,
+		     u64Bytes - u64DoneBytes, u8Write);
+
+    if (iCallBytes > 0)
+    {
+      u64DoneBytes += iCallBytes;
+    }
+  }
+
+  return u64DoneBytes;
+}
+
+
+
+// Retries a failed transfer of the buffer part at u64Start in
+// smaller pieces down to single logical blocks, so that only the
+// really bad ones get recorded.
+static void DC_NarrowBadIo(tDcState* pxState, tDcBuffer* pxBuf, uint64_t u64Start,
+			   uint64_t u64Bytes, uint8_t u8Write)
+{
+  uint64_t u64Unit = u64Bytes / ADT_DC_RETRY_SPLIT;
+  uint64_t u64Offset = pxBuf->u64Offset + u64Start;
+  uint64_t u64Pos = 0;
+  uint64_t u64PieceBytes = 0;
+
+  if (u64Bytes <= pxState->u32BlockSize)
+  {
+    DC_AddBadExtent(pxState, u64Offset, u64Offset + u64Bytes,
+		    (u8Write ? ADT_DC_EXTENT_WRITE_ERROR : ADT_DC_EXTENT_READ_ERROR));
+
+    if (!u8Write)
+    {
+      // Already recorded, do not let the verifier report it again
+      DC_AddBufferSkip(pxBuf, u64Offset, u64Offset + u64Bytes);
+    }
+
+    return;
+  }
+  u64Unit = ((u64Unit + pxState->u32BlockSize - 1) / pxState->u32BlockSize) * pxState->u32BlockSize;
+
+  for (u64Pos = 0; u64Pos < u64Bytes; u64Pos += u64Unit)
+  {
+    u64PieceBytes = (((u64Bytes - u64Pos) > u64Unit) ? u64Unit : (u64Bytes - u64Pos));
+
+    if (u64DC_Transfer(pxState, pxBuf->pMem + u64Start + u64Pos, u64Offset + u64Pos,
+		       u64PieceBytes, u8Write) != u64PieceBytes)
+    {
+      DC_NarrowBadIo(pxState, pxBuf, u64Start + u64Pos, u64PieceBytes, u8Write);
+    }
+  }
+}
+
+
+
+static uint8_t bDC_QueueInit(tDcQueue* pxQueue, uint32_t u32Capacity)
+{
+  pxQueue->u32Capacity = u32Capacity;
+  pxQueue->u32Head = 0;
+  pxQueue->u32Tail = 0;
+  pxQueue->ppSlots = malloc(u32Capacity * sizeof(void*));
+
+  if (pxQueue->ppSlots == NULL)
+  {
+    return 0;
+  }
+  if (sem_init(&(pxQueue->xSemItems), 0, 0) != 0)
+  {
+    free(pxQueue->ppSlots);
+    pxQueue->ppSlots = NULL;
+
+    return 0;
+  }
+
+  return 1;
+}
+
+
+
+static void DC_QueueDestroy(tDcQueue* pxQueue)
+{
+  if (pxQueue->ppSlots != NULL)
+  {
+    sem_destroy(&(pxQueue->xSemItems));
+    free(pxQueue->ppSlots);
+    pxQueue->ppSlots = NULL;
+  }
+}
+
+
+
+// Single producer only. Never full, since there are never
+// more items around than the queue was sized for.
+static void DC_QueuePush(tDcQueue* pxQueue, void* pItem)
+{
+  uint32_t u32Tail = __atomic_load_n(&(pxQueue->u32Tail), __ATOMIC_RELAXED);
+
+  pxQueue->ppSlots[u32Tail % pxQueue->u32Capacity] = pItem;
+  __atomic_store_n(&(pxQueue->u32Tail), u32Tail + 1, __ATOMIC_RELEASE);
+  // Semaphore is only for sleeping when empty
+  sem_post(&(pxQueue->xSemItems));
+}
+
+
+
+// Single consumer only. Sleeps until there is something.
+static void* pDC_QueuePop(tDcQueue* pxQueue)
+{
+  uint32_t u32Head = __atomic_load_n(&(pxQueue->u32Head), __ATOMIC_RELAXED);
+  void* pItem = NULL;
+
+  while (sem_wait(&(pxQueue->xSemItems)) != 0)
+  {
+    // Interrupted, try again
+  }
+  while (__atomic_load_n(&(pxQueue->u32Tail), __ATOMIC_ACQUIRE) == u32Head)
+  {
+    // Cannot really happen after the semaphore, but be safe
+  }
+  pItem = pxQueue->ppSlots[u32Head % pxQueue->u32Capacity];
+  __atomic_store_n(&(pxQueue->u32Head), u32Head + 1, __ATOMIC_RELEASE);
+
+  return pItem;
+}
+
+
+
+static void DC_PoolDestroy(tDcPool* pxPool)
+{
+  uint32_t i;
+
+  if (pxPool->pxBufs != NULL)
+  {
+    for (i = 0; i < pxPool->u32BufCount; i++)
+    {
+      DC_FreeBuffer(&(pxPool->pxBufs[i]));
+    }
+  }
+  free(pxPool->pxBufs);
+  free(pxPool->ppxFree);
+  pthread_cond_destroy(&(pxPool->xCond));
+  pthread_mutex_destroy(&(pxPool->xMutex));
+}
+
+
+
+// Buffers are sized for the state given, which is the template
+// every device state gets copied from.
+static uint8_t bDC_PoolInit(tDcPool* pxPool, tDcState* pxState)
+{
+  uint32_t i;
+
+  memset(pxPool, 0, sizeof(*pxPool));
+  pthread_mutex_init(&(pxPool->xMutex), NULL);
+  pthread_cond_init(&(pxPool->xCond), NULL);
+  pxPool->pxBufs = calloc(pxState->u32BufCount, sizeof(tDcBuffer));
+  pxPool->ppxFree = calloc(pxState->u32BufCount, sizeof(tDcBuffer*));
+
+  if ((pxPool->pxBufs == NULL) || (pxPool->ppxFree == NULL))
+  {
+    DC_PoolDestroy(pxPool);
+
+    return 0;
+  }
+  for (i = 0; i < pxState->u32BufCount; i++)
+  {
+    pxPool->u32BufCount++;
+
+    if (!bDC_AllocBuffer(pxState, &(pxPool->pxBufs[i])))
+    {
+      DC_PoolDestroy(pxPool);
+
+      return 0;
+    }
+    pxPool->ppxFree[pxPool->u32FreeCount] = &(pxPool->pxBufs[i]);
+    pxPool->u32FreeCount++;
+  }
+
+  return 1;
+}
+
+
+
+// Sleeps until some device gives a buffer back. NULL means the
+// pipeline of this device is being stopped.
+static tDcBuffer* pxDC_PoolGet(tDcPool* pxPool, tDcState* pxState)
+{
+  tDcBuffer* pxBuf = NULL;
+
+  pthread_mutex_lock(&(pxPool->xMutex));
+
+  while ((pxPool->u32FreeCount == 0) && (!pxState->u8Abort))
+  {
+    pthread_cond_wait(&(pxPool->xCond), &(pxPool->xMutex));
+  }
+  if (!pxState->u8Abort)
+  {
+    pxPool->u32FreeCount--;
+    pxBuf = pxPool->ppxFree[pxPool->u32FreeCount];
+  }
+  pthread_mutex_unlock(&(pxPool->xMutex));
+
+  return pxBuf;
+}
+
+
+
+static void DC_PoolPut(tDcPool* pxPool, tDcBuffer* pxBuf)
+{
+  pthread_mutex_lock(&(pxPool->xMutex));
+  pxPool->ppxFree[pxPool->u32FreeCount] = pxBuf;
+  pxPool->u32FreeCount++;
+  pthread_cond_broadcast(&(pxPool->xCond));
+  pthread_mutex_unlock(&(pxPool->xMutex));
+}
+
+
+
+// Abort flag is set under the pool lock so no waiter misses it
+static void DC_PoolAbort(tDcPool* pxPool, tDcState* pxState)
+{
+  pthread_mutex_lock(&(pxPool->xMutex));
+  pxState->u8Abort = 1;
+  pthread_cond_broadcast(&(pxPool->xCond));
+  pthread_mutex_unlock(&(pxPool->xMutex));
+}
+
+
+
+// Empty buffers come from the device's own ring, or from the
+// shared pool when many devices are tested at once.
+static tDcBuffer* pxDC_GetFreeBuffer(tDcState* pxState)
+{
+  if (pxState->pxPool != NULL)
+  {
+    return pxDC_PoolGet(pxState->pxPool, pxState);
+  }
+
+  return pDC_QueuePop(&(pxState->xFreeQueue));
+}
+
+
+
+static void DC_PutFreeBuffer(tDcState* pxState, tDcBuffer* pxBuf)
+{
+  if (pxState->pxPool != NULL)
+  {
+    DC_PoolPut(pxState->pxPool, pxBuf);
+
+    return;
+  }
+  DC_QueuePush(&(pxState->xFreeQueue), pxBuf);
+}
+
+
+
+// Fills empty buffers in device order and passes them on
+static void* pDC_BufferGenerator(void* pParams)
+{
+  tDcState* pxState = (tDcState*)pParams;
+  tDcBuffer* pxBuf = NULL;
+  uint64_t u64LeftBytes = 0;
+
+  while (pxState->u64GenOffset < pxState->u64RegionEnd)
+  {
+    pxBuf = pxDC_GetFreeBuffer(pxState);
+
+    if (pxBuf == NULL)
+    {
+      break;
+    }
+    if (pxState->u8Abort)
+    {
+      DC_PutFreeBuffer(pxState, pxBuf);
+
+      break;
+    }
+    u64LeftBytes = pxState->u64RegionEnd - pxState->u64GenOffset;
+    pxBuf->u64Offset = pxState->u64GenOffset;
+    pxBuf->u64Bytes = ((u64LeftBytes > pxState->u32BufSize) ? pxState->u32BufSize : u64LeftBytes);
+    DC_PrepareBuffer(pxState, pxBuf);
+    pxState->u64GenOffset += pxBuf->u64Bytes;
+
+    DC_QueuePush(&(pxState->xFullQueue), pxBuf);
+  }
+
+  return NULL;
+}
+
+
+
+// Checks read buffers in place and hands them back for reading
+static void* pDC_BufferVerifier(void* pParams)
+{
+  tDcState* pxState = (tDcState*)pParams;
+  tDcBuffer* pxBuf = NULL;
+
+  while (1)
+  {
+    pxBuf = pDC_QueuePop(&(pxState->xFullQueue));
+
+    if (pxBuf == NULL)
+    {
+      break;
+    }
+    if (pxState->u8Abort)
+    {
+      DC_PutFreeBuffer(pxState, pxBuf);
+
+      break;
+    }
+    if (!bDC_CheckBuffer(pxState, pxBuf))
+    {
+      // Buffer back so that the reader wakes up to notice
+      pxState->u8VerifyFailed = 1;
+      DC_PutFreeBuffer(pxState, pxBuf);
+
+      break;
+    }
+    // Everything before this has been checked, checkpoints go by it
+    __atomic_store_n(&(pxState->u64VerifiedOffset), pxBuf->u64Offset + pxBuf->u64Bytes,
+		     __ATOMIC_RELEASE);
+    DC_PutFreeBuffer(pxState, pxBuf);
+  }
+
+  return NULL;
+}
+
+
+
+// With drain, verifier still gets to check everything queued so far
+static void DC_StopPipeline(tDcState* pxState, uint8_t u8Drain)
+{
+  uint32_t i;
+  tDcBuffer* pxBuf = NULL;
+
+  if (!pxState->u8PipelineRunning)
+  {
+    return;
+  }
+  // Wake up the thread in case it sleeps on an empty queue
+  pxState->u8Abort = (u8Drain ? 0 : 1);
+
+  if (pxState->u8PipelineWrite && (pxState->pxPool != NULL))
+  {
+    DC_PoolAbort(pxState->pxPool, pxState);
+  }
+  else
+  {
+    DC_QueuePush((pxState->u8PipelineWrite ?
+		  &(pxState->xFreeQueue) : &(pxState->xFullQueue)), NULL);
+  }
+  pthread_join(pxState->xAllocatorThread, NULL);
+  DC_StopGenWorkers(pxState);
+  pxState->u8PipelineRunning = 0;
+
+  if (pxState->pxPool != NULL)
+  {
+    // Whatever got stuck in the pipeline goes back to the pool
+    while (__atomic_load_n(&(pxState->xFullQueue.u32Tail), __ATOMIC_ACQUIRE) !=
+	   pxState->xFullQueue.u32Head)
+    {
+      pxBuf = pDC_QueuePop(&(pxState->xFullQueue));
+
+      if (pxBuf != NULL)
+      {
+	DC_PoolPut(pxState->pxPool, pxBuf);
+      }
+    }
+  }
+  else
+  {
+    for (i = 0; i < pxState->u32BufCount; i++)
+    {
+      DC_FreeBuffer(&(pxState->pxBufs[i]));
+    }
+    free(pxState->pxBufs);
+    pxState->pxBufs = NULL;
+  }
+  DC_QueueDestroy(&(pxState->xFreeQueue));
+  DC_QueueDestroy(&(pxState->xFullQueue));
+}
+
+
+
+static uint8_t bDC_StartPipeline(tDcState* pxState, uint8_t u8Write)
+{
+  uint32_t i;
+
+  pxState->u8Abort = 0;
+  pxState->u8VerifyFailed = 0;
+  pxState->u8PipelineWrite = u8Write;
+
+  // One extra slot in both queues for the wake up at stop. With
+  // the pool the count is the pool size, all of it may pass here.
+  if (!bDC_QueueInit(&(pxState->xFreeQueue), pxState->u32BufCount + 1))
+  {
+    DC_Message(pxState, "Error: Malloc failed\n");
+
+    return 0;
+  }
+  if (!bDC_QueueInit(&(pxState->xFullQueue), pxState->u32BufCount + 1))
+  {
+    DC_Message(pxState, "Error: Malloc failed\n");
+    DC_QueueDestroy(&(pxState->xFreeQueue));
+
+    return 0;
+  }
+  if (pxState->pxPool == NULL)
+  {
+    pxState->pxBufs = calloc(pxState->u32BufCount, sizeof(tDcBuffer));
+
+    for (i = 0; (pxState->pxBufs != NULL) && (i < pxState->u32BufCount); i++)
+    {
+      if (!bDC_AllocBuffer(pxState, &(pxState->pxBufs[i])))
+      {
+	for (i = 0; i < pxState->u32BufCount; i++)
+	{
+	  DC_FreeBuffer(&(pxState->pxBufs[i]));
+	}
+	free(pxState->pxBufs);
+	pxState->pxBufs = NULL;
+      }
+      else
+      {
+	DC_QueuePush(&(pxState->xFreeQueue), &(pxState->pxBufs[i]));
+      }
+    }
+    if (pxState->pxBufs == NULL)
+    {
+      DC_Message(pxState, "Error: Malloc failed\n");
+      DC_QueueDestroy(&(pxState->xFreeQueue));
+      DC_QueueDestroy(&(pxState->xFullQueue));
+
+      return 0;
+    }
+  }
+  // Now it is time to set counters
+  pxState->u64GenOffset = pxState->u64RegionBegin;
+  pxState->u64LastDataLeftBytes = pxState->u64RegionEnd - pxState->u64RegionBegin;
+  pxState->u64NowDataLeftBytes = pxState->u64RegionEnd - pxState->u64RegionBegin;
+  pxState->u64StartDataLeftBytes = pxState->u64RegionEnd - pxState->u64RegionBegin;
+  pxState->u64DurableOffset = pxState->u64RegionBegin;
+  pxState->u64VerifiedOffset = pxState->u64RegionBegin;
+  gettimeofday(&(pxState->xCheckpointTime), NULL);
+
+  DC_StartGenWorkers(pxState);
+  pthread_create(&(pxState->xAllocatorThread), NULL,
+		 (u8Write ? pDC_BufferGenerator : pDC_BufferVerifier), pxState);
+  pxState->u8PipelineRunning = 1;
+
+  return 1;
+}
+
+
+
+// Stripes count into the device too, so its progress covers them all.
+// In combined test only the reader does, device is done when verified.
+static void DC_CountDone(tDcState* pxState, uint64_t u64Bytes)
+{
+  pxState->u64NowDataLeftBytes -= u64Bytes;
+
+  if ((pxState->pxParent != NULL) &&
+      ((__atomic_load_n(&(pxState->pxParent->u8Phase), __ATOMIC_ACQUIRE) != ADT_DC_PHASE_COMBINED) || (pxState->pxLeader != NULL)))
+  {
+    __atomic_sub_fetch(&(pxState->pxParent->u64NowDataLeftBytes), u64Bytes, __ATOMIC_RELAXED);
+  }
+}
+
+
+
+static uint8_t bDC_StripeCancelled(tDcState* pxState)
+{
+  return ((pxState->pxParent != NULL) && pxState->pxParent->u8StripeFailed);
+}
+
+
+
+// Waits until the writer is far enough past the given offset, or
+// done. Returns 0 if the test was called off meanwhile.
+static uint8_t bDC_FollowWriter(tDcState* pxState, uint64_t u64End)
+{
+  tDcState* pxLeader = pxState->pxLeader;
+  struct timespec xPoll = { 0, ADT_DC_FOLLOW_POLL_NS };
+
+  while ((__atomic_load_n(&(pxLeader->u64WrittenOffset), __ATOMIC_ACQUIRE) <
+	  (u64End + pxState->u64VerifyLagBytes)) &&
+	 (__atomic_load_n(&(pxLeader->u8Phase), __ATOMIC_ACQUIRE) != ADT_DC_PHASE_DONE))
+  {
+    if (bDC_StripeCancelled(pxState))
+    {
+      return 0;
+    }
+    nanosleep(&xPoll, NULL);
+  }
+
+  return (!bDC_StripeCancelled(pxState));
+}
+
+
+
+// Written data must come from the disk, not from the page cache
+static void DC_DropCached(tDcState* pxState, uint64_t u64Offset, uint64_t u64Bytes)
+{
+  if (pxState->u8Direct)
+  {
+    return;
+  }
+  sync_file_range(pxState->iFd, u64Offset, u64Bytes, SYNC_FILE_RANGE_WAIT_BEFORE |
+		  SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+  posix_fadvise(pxState->iFd, u64Offset, u64Bytes, POSIX_FADV_DONTNEED);
+}
+
+
+
+// Read data is in our buffer already, cached copy is of no use
+static void DC_ForgetRead(tDcState* pxState, uint64_t u64Offset, uint64_t u64Bytes)
+{
+  if (!pxState->u8Direct)
+  {
+    posix_fadvise(pxState->iFd, u64Offset, u64Bytes, POSIX_FADV_DONTNEED);
+  }
+}
+
+
+
+// Keeps at most the dirty window of written data in the page cache.
+// Fresh data is sent to the disk right away, and what is older than
+// the window is waited on and dropped. With u8Final all of it is.
+static void DC_WriteBehind(tDcState* pxState, uint64_t u64EndOffset, uint8_t u8Final)
+{
+  uint64_t u64EvictEnd = u64EndOffset;
+
+  if (pxState->u8Direct)
+  {
+    return;
+  }
+  if (!u8Final)
+  {
+    sync_file_range(pxState->iFd, pxState->u64EvictedOffset,
+		    u64EndOffset - pxState->u64EvictedOffset, SYNC_FILE_RANGE_WRITE);
+
+    if ((u64EndOffset - pxState->u64EvictedOffset) <= ADT_DC_DIRTY_WINDOW)
+    {
+      return;
+    }
+    u64EvictEnd = u64EndOffset - ADT_DC_DIRTY_WINDOW;
+  }
+  DC_DropCached(pxState, pxState->u64EvictedOffset, u64EvictEnd - pxState->u64EvictedOffset);
+  pxState->u64EvictedOffset = u64EvictEnd;
+}
+
+
+
+// Moves the scratch region in pieces of the current buffer size for
+// a while, returns MiB/s. Buffer holds the right pattern for the
+// region, so writing it is harmless even to a resumed test.
+static float fDC_TuneRun(tDcState* pxState, void* pBufMem, uint64_t u64RegionBytes)
+{
+  uint64_t u64StartNanos = u64DC_NowNanos();
+  uint64_t u64DoneBytes = 0;
+  uint64_t u64Offset = 0;
+  uint64_t u64Bytes = 0;
+
+  do
+  {
+    for (u64Offset = 0; u64Offset < u64RegionBytes; u64Offset += u64Bytes)
+    {
+      u64Bytes = (((u64RegionBytes - u64Offset) > pxState->u32BufSize) ?
+		  pxState->u32BufSize : (u64RegionBytes - u64Offset));
+
+      if (u64DC_Transfer(pxState, pBufMem + u64Offset, u64Offset, u64Bytes,
+			 pxState->u8Write) != u64Bytes)
+      {
+	return 0.0;
+      }
+      u64DoneBytes += u64Bytes;
+    }
+    if (pxState->u8Write)
+    {
+      fsync(pxState->iFd);
+    }
+    else
+    {
+      DC_DropCached(pxState, 0, u64RegionBytes);
+    }
+  }
+  while ((u64DC_NowNanos() - u64StartNanos) < (ADT_DC_TUNE_TIME_MS * 1000000));
+
+  return (1.0 * u64DoneBytes) /
+    ((1.0 * ADT_BYTES_IN_MEBIBYTE) * ((u64DC_NowNanos() - u64StartNanos) / 1000000000.0));
+}
+
+
+
+// Tries request sizes, or with io_uring sizes and queue depths, on
+// the start of the device in the direction the test begins with.
+// Picks the smallest setting that gets close to the fastest one.
+static uint8_t bDC_TuneDevice(tDcState* pxState)
+{
+  static const uint32_t au32BufSizes[] = { 256 * ADT_BYTES_IN_KIBIBYTE, ADT_BYTES_IN_MEBIBYTE,
+					   4 * ADT_BYTES_IN_MEBIBYTE, 16 * ADT_BYTES_IN_MEBIBYTE,
+					   64 * ADT_BYTES_IN_MEBIBYTE };
+  static const uint32_t au32IoSizes[] = { 64 * ADT_BYTES_IN_KIBIBYTE, 256 * ADT_BYTES_IN_KIBIBYTE,
+					  ADT_BYTES_IN_MEBIBYTE, 4 * ADT_BYTES_IN_MEBIBYTE };
+  static const uint32_t au32Depths[] = { 1, 4, 16, 64 };
+  tDcState* pxProbe = NULL;
+  tDcBuffer xBuf;
+  uint64_t u64RegionBytes = ADT_DC_TUNE_REGION;
+  uint32_t u32Sizes = 0;
+  uint32_t u32Depths = 1;
+  uint32_t i;
+  uint32_t j;
+  uint32_t u32Count = 0;
+  uint32_t u32Best = 0;
+  float afSpeeds[(sizeof(au32IoSizes) / sizeof(au32IoSizes[0])) * (sizeof(au32Depths) / sizeof(au32Depths[0]))];
+  float fBest = 0.0;
+  uint8_t u8Result = 1;
+  char sSizeHumReadBuf[ADT_GEN_BUF_SIZE] = { 0 };
+
+  if (pxState->u8Uring ? (pxState->u8IoSizeGiven && pxState->u8QueueDepthGiven) :
+      pxState->u8BufSizeGiven)
+  {
+    printf("Nothing to tune for %s, all set on command line\n", pxState->sDevice);
+
+    return 1;
+  }
+  // Probe copy keeps the timings out of the real statistics
+  pxProbe = malloc(sizeof(tDcState));
+
+  if (u64RegionBytes > pxState->u64DevSizeBytes)
+  {
+    u64RegionBytes = pxState->u64DevSizeBytes & ~(ADT_DC_GEN_SLICE_ALIGN - 1);
+  }
+  u64RegionBytes -= (u64RegionBytes % pxState->u32BlockSize);
+
+  if ((pxProbe == NULL) || (u64RegionBytes < ADT_DC_MIN_BUF_SIZE))
+  {
+    printf("Error: Unable to tune %s\n", pxState->sDevice);
+    free(pxProbe);
+
+    return 0;
+  }
+  memcpy(pxProbe, pxState, sizeof(tDcState));
+  pxProbe->pxZones = NULL;
+  pxProbe->pxParent = NULL;
+  pxProbe->u32BufSize = (uint32_t)u64RegionBytes;
+  memset(pxProbe->axLatency, 0, sizeof(pxProbe->axLatency));
+  pthread_mutex_init(&(pxProbe->xLatencyMutex), NULL);
+
+  if (pxProbe->u8Uring)
+  {
+    u32Sizes = (pxState->u8IoSizeGiven ? 1 : (sizeof(au32IoSizes) / sizeof(au32IoSizes[0])));
+    u32Depths = (pxState->u8QueueDepthGiven ? 1 : (sizeof(au32Depths) / sizeof(au32Depths[0])));
+    // Ring is made for the deepest one, shallower just use less of it
+    pxProbe->u32QueueDepth = (pxState->u8QueueDepthGiven ?
+			      pxState->u32QueueDepth : au32Depths[u32Depths - 1]);
+  }
+  else
+  {
+    u32Sizes = sizeof(au32BufSizes) / sizeof(au32BufSizes[0]);
+  }
+  memset(&xBuf, 0, sizeof(xBuf));
+
+  if ((!bDC_AllocBuffer(pxProbe, &xBuf)) ||
+      (iDC_OpenDevice(pxProbe, (pxState->u8Write ? O_WRONLY : O_RDONLY)) == -1))
+  {
+    printf("Error: Unable to tune %s\n", pxState->sDevice);
+    DC_FreeBuffer(&xBuf);
+    pthread_mutex_destroy(&(pxProbe->xLatencyMutex));
+    free(pxProbe);
+
+    return 0;
+  }
+  if (pxState->u8Write)
+  {
+    ADT_PatternFill(xBuf.pMem, u64RegionBytes, 0);
+  }
+  printf("Tuning %s with %s\n", pxState->sDevice, (pxState->u8Write ? "writes" : "reads"));
+
+  for (i = 0; u8Result && (i < u32Sizes); i++)
+  {
+    for (j = 0; u8Result && (j < u32Depths); j++)
+    {
+      afSpeeds[(i * u32Depths) + j] = 0.0;
+
+      if (pxState->u8Uring)
+      {
+	pxProbe->u32IoSize = (pxState->u8IoSizeGiven ? pxState->u32IoSize : au32IoSizes[i]);
+	pxProbe->u32QueueDepth = (pxState->u8QueueDepthGiven ? pxState->u32QueueDepth : au32Depths[j]);
+	pxProbe->u32BufSize = (uint32_t)u64RegionBytes;
+
+	if ((((uint64_t)pxProbe->u32IoSize) * pxProbe->u32QueueDepth) > u64RegionBytes)
+	{
+	  // Could not keep that many in flight anyway
+	  continue;
+	}
+	ADT_BytesToHumanReadable(pxProbe->u32IoSize, sSizeHumReadBuf);
+	printf("%s requests, depth %u: ", sSizeHumReadBuf, pxProbe->u32QueueDepth);
+      }
+      else
+      {
+	if (au32BufSizes[i] > u64RegionBytes)
+	{
+	  continue;
+	}
+	pxProbe->u32BufSize = au32BufSizes[i];
+	ADT_BytesToHumanReadable(pxProbe->u32BufSize, sSizeHumReadBuf);
+	printf("%s requests: ", sSizeHumReadBuf);
+      }
+      fflush(stdout);
+      afSpeeds[(i * u32Depths) + j] = fDC_TuneRun(pxProbe, xBuf.pMem, u64RegionBytes);
+
+      if (afSpeeds[(i * u32Depths) + j] == 0.0)
+      {
+	printf("failed\n");
+	u8Result = 0;
+
+	break;
+      }
+      printf("%.2f MiB/s\n", afSpeeds[(i * u32Depths) + j]);
+      u32Count++;
+
+      if (afSpeeds[(i * u32Depths) + j] > fBest)
+      {
+	fBest = afSpeeds[(i * u32Depths) + j];
+      }
+    }
+  }
+  DC_CloseDevice(pxProbe);
+  DC_FreeBuffer(&xBuf);
+  pthread_mutex_destroy(&(pxProbe->xLatencyMutex));
+  free(pxProbe);
+
+  if ((!u8Result) || (u32Count == 0))
+  {
+    printf("Error: Tuning %s failed\n", pxState->sDevice);
+
+    return 0;
+  }
+  // Smaller and shallower come first, take the first good enough
+  for (u32Best = 0; (afSpeeds[u32Best] * 100.0) < (fBest * ADT_DC_TUNE_GOOD_PERCENT); u32Best++)
+  {
+    ;
+  }
+  if (pxState->u8Uring)
+  {
+    if (!pxState->u8IoSizeGiven)
+    {
+      pxState->u32IoSize = au32IoSizes[u32Best / u32Depths];
+    }
+    if (!pxState->u8QueueDepthGiven)
+    {
+      pxState->u32QueueDepth = au32Depths[u32Best % u32Depths];
+    }
+    ADT_BytesToHumanReadable(pxState->u32IoSize, sSizeHumReadBuf);
+    printf("Chose %s requests, depth %u for %s\n", sSizeHumReadBuf,
+	   pxState->u32QueueDepth, pxState->sDevice);
+  }
+  else
+  {
+    pxState->u32BufSize = au32BufSizes[u32Best];
+    ADT_BytesToHumanReadable(pxState->u32BufSize, sSizeHumReadBuf);
+    printf("Chose %s requests for %s\n", sSizeHumReadBuf, pxState->sDevice);
+  }
+
+  return 1;
+}
+
+
+
+// Runs the stripes through the same tests, so needed before them
+static uint8_t bDC_StripedTest(tDcState* pxState, uint8_t u8Write);
+static uint8_t bDC_CombinedTest(tDcState* pxState);
+
+
+
+static uint8_t bDC_WriteTest(tDcState* pxState)
+{
+  uint64_t u64WrittenCallBytes = 0;
+  tDcBuffer* pxBuf = NULL;
+
+  if ((pxState->u32Stripes > 1) && (pxState->pxParent == NULL))
+  {
+    return bDC_StripedTest(pxState, 1);
+  }
+  if (pxState->pxParent == NULL)
+  {
+    pxState->u64RegionBegin = u64DC_StartOffset(pxState, ADT_DC_PHASE_WRITE, 0, 0);
+  }
+  if (!bDC_StartPipeline(pxState, 1))
+  {
+    return 0;
+  }
+  if (iDC_OpenDevice(pxState, O_WRONLY) == -1)
+  {
+    DC_Message(pxState, "Error: Unable to open the device in write mode\n");
+    DC_StopPipeline(pxState, 0);
+
+    return 0;
+  }
+  pxState->u64EvictedOffset = pxState->u64RegionBegin;
+
+  if (!pxState->u8Multi)
+  {
+    printf("Write test starting\n");
+    // Write couple of newlines in sync to the prevline sequences
+    printf("\n\n");
+  }
+  // Make initial zero print a bit earlier:
+  gettimeofday(&(pxState->xLastTime), NULL);
+  pxState->xLastTime.tv_sec -= (ADT_DC_PROGRESS_UPDATE_INTERVAL + 1);
+  // Actual start of routine loop
+  gettimeofday(&(pxState->xStartTime), NULL);
+  __atomic_store_n(&(pxState->u8Phase), ADT_DC_PHASE_WRITE, __ATOMIC_RELEASE);
+  
+  // Generator runs ahead filling the ring, we just write in order
+  while ((pxState->u64NowDataLeftBytes > 0) && (!bDC_StripeCancelled(pxState)))
+  {
+    pxBuf = pDC_QueuePop(&(pxState->xFullQueue));
+    u64WrittenCallBytes = u64DC_Transfer(pxState, pxBuf->pMem, pxBuf->u64Offset,
+					 pxBuf->u64Bytes, 1);
+
+    if ((u64WrittenCallBytes != pxBuf->u64Bytes) && pxState->u8Continue)
+    {
+      DC_NarrowBadIo(pxState, pxBuf, 0, pxBuf->u64Bytes, 1);
+    }
+    else if (u64WrittenCallBytes != pxBuf->u64Bytes)
+    {
+      DC_Message(pxState, "Error: Problem writing bytes %" PRIu64 "\n", pxBuf->u64Offset);
+      DC_PutFreeBuffer(pxState, pxBuf);
+      DC_StopPipeline(pxState, 0);
+      DC_CloseDevice(pxState);
+
+      return 0;
+    }
+    // Update counters and print info
+    DC_WriteBehind(pxState, pxBuf->u64Offset + pxBuf->u64Bytes, 0);
+    __atomic_store_n(&(pxState->u64WrittenOffset), pxBuf->u64Offset + pxBuf->u64Bytes,
+		     __ATOMIC_RELEASE);
+    DC_CountDone(pxState, pxBuf->u64Bytes);
+    DC_Checkpoint(pxState, pxBuf->u64Offset + pxBuf->u64Bytes);
+    DC_PutFreeBuffer(pxState, pxBuf);
+    DC_PrintProgress(pxState, 0);
+  }
+  if (!pxState->u8Multi)
+  {
+    printf("\nSyncinc...\n\n\n");
+  }
+  fsync(pxState->iFd);
+  DC_WriteBehind(pxState, pxState->u64RegionEnd, 1);
+  DC_PrintProgress(pxState, 1);
+
+  if (!pxState->u8Multi)
+  {
+    printf("\nDone all writing!\n");
+  }
+  DC_CloseDevice(pxState);
+  DC_StopPipeline(pxState, 0);
+  
+  return 1;
+}
+
+
+
+static uint8_t bDC_ReadTest(tDcState* pxState)
+{
+  uint64_t u64ReadCallBytes = 0;
+  uint64_t u64LeftBytes = 0;
+  uint64_t u64Offset = 0;
+  tDcBuffer* pxBuf = NULL;
+
+  if ((pxState->u32Stripes > 1) && (pxState->pxParent == NULL))
+  {
+    return bDC_StripedTest(pxState, 0);
+  }
+  if (pxState->pxParent == NULL)
+  {
+    pxState->u64RegionBegin = u64DC_StartOffset(pxState, ADT_DC_PHASE_READ, 0, 0);
+  }
+  if (!bDC_StartPipeline(pxState, 0))
+  {
+    return 0;
+  }
+  u64Offset = pxState->u64RegionBegin;
+  if (iDC_OpenDevice(pxState, O_RDONLY) == -1)
+  {
+    DC_Message(pxState, "Error: Unable to open the device in read mode\n");
+    DC_StopPipeline(pxState, 0);
+
+    return 0;
+  }
+  if (pxState->pxLeader == NULL)
+  {
+    // Whatever is cached from before must not pass for the disk
+    DC_DropCached(pxState, pxState->u64RegionBegin,
+		  pxState->u64RegionEnd - pxState->u64RegionBegin);
+  }
+  if (!pxState->u8Multi)
+  {
+    printf("Read test starting\n");
+    // Write couple of newlines in sync to the prevline sequences
+    printf("\n\n");
+  }
+  // Make initial zero print a bit earlier:
+  gettimeofday(&(pxState->xLastTime), NULL);
+  pxState->xLastTime.tv_sec -= (ADT_DC_PROGRESS_UPDATE_INTERVAL + 1);
+  // Actual start of routine loop
+  gettimeofday(&(pxState->xStartTime), NULL);
+  __atomic_store_n(&(pxState->u8Phase), ADT_DC_PHASE_READ, __ATOMIC_RELEASE);
+  
+  // We read in order into the ring, verifier checks behind us
+  while ((pxState->u64NowDataLeftBytes > 0) && (!bDC_StripeCancelled(pxState)))
+  {
+    pxBuf = pxDC_GetFreeBuffer(pxState);
+
+    if (pxState->u8VerifyFailed)
+    {
+      DC_PutFreeBuffer(pxState, pxBuf);
+
+      break;
+    }
+    u64LeftBytes = pxState->u64RegionEnd - u64Offset;
+    pxBuf->u64Offset = u64Offset;
+    pxBuf->u64Bytes = ((u64LeftBytes > pxState->u32BufSize) ? pxState->u32BufSize : u64LeftBytes);
+
+    if (pxState->pxLeader != NULL)
+    {
+      if (!bDC_FollowWriter(pxState, pxBuf->u64Offset + pxBuf->u64Bytes))
+      {
+	DC_PutFreeBuffer(pxState, pxBuf);
+
+	break;
+      }
+      DC_DropCached(pxState, pxBuf->u64Offset, pxBuf->u64Bytes);
+    }
+    pxBuf->u32SkipCount = 0;
+    u64ReadCallBytes = u64DC_Transfer(pxState, pxBuf->pMem, pxBuf->u64Offset,
+				      pxBuf->u64Bytes, 0);
+
+    if ((u64ReadCallBytes != pxBuf->u64Bytes) && pxState->u8Continue)
+    {
+      DC_NarrowBadIo(pxState, pxBuf, 0, pxBuf->u64Bytes, 0);
+    }
+    else if (u64ReadCallBytes != pxBuf->u64Bytes)
+    {
+      DC_Message(pxState, "Error: Problem reading bytes %" PRIu64 "\n", pxBuf->u64Offset);
+      DC_PutFreeBuffer(pxState, pxBuf);
+      DC_StopPipeline(pxState, 0);
+      DC_CloseDevice(pxState);
+      
+      return 0;
+    }
+    // Update counters and print info. Buffer is not ours anymore
+    // once queued, pool may hand it to another device right away.
+    DC_ForgetRead(pxState, pxBuf->u64Offset, pxBuf->u64Bytes);
+    u64Offset += pxBuf->u64Bytes;
+    DC_CountDone(pxState, pxBuf->u64Bytes);
+    DC_QueuePush(&(pxState->xFullQueue), pxBuf);
+    DC_Checkpoint(pxState, __atomic_load_n(&(pxState->u64VerifiedOffset), __ATOMIC_ACQUIRE));
+    DC_PrintProgress(pxState, 0);
+  }
+  // Verifier still has to finish what is queued
+  DC_StopPipeline(pxState, 1);
+  DC_CloseDevice(pxState);
+
+  if (pxState->u8VerifyFailed)
+  {
+    DC_Message(pxState, "\nError: Comparing failed at byte %" PRIu64 " (%s)\n",
+	       pxState->u64BadOffset, asDcBadKinds[pxState->u8BadKind]);
+    DC_Message(pxState, "Expected 0x%016" PRIx64 " but read 0x%016" PRIx64 " at byte %" PRIu64 "\n",
+	   pxState->u64BadExpected, pxState->u64BadActual,
+	   pxState->u64BadOffset & ~(ADT_DC_RUNNING_NUM_SIZE_BYTES - 1));
+
+    return 0;
+  }
+  // No sync needed
+  DC_PrintProgress(pxState, 1);
+
+  if (pxState->u8Multi)
+  {
+    // Main thread reports for all devices
+    return 1;
+  }
+  if (pxState->u32ExtentCount > 0)
+  {
+    printf("\nDone all reading, bad extents found!\n");
+
+    return 1;
+  }
+  printf("\nDone all reading, compare OK!\n");
+  
+  return 1;
+}
+
+// Device wipes itself in chunks, so there is progress to show and
+// a way it does not support falls back to zero writes early on.
+// Then a sample all over is read back, it must be zeros, except
+// after discards that do not promise that.
+static uint8_t bDC_WipeDevice(tDcState* pxState)
+{
+  uint64_t u64Offset = 0;
+  uint64_t u64Bytes = 0;
+  uint64_t u64BadOffset = 0;
+  uint64_t u64StartNanos = 0;
+  uint8_t u8Wipe = pxState->u8WipeWay;
+  uint8_t u8Used = 0;
+  uint8_t u8Zeroed = 1;
+
+  if (iDC_OpenDevice(pxState, O_RDWR) == -1)
+  {
+    DC_Message(pxState, "Error: Unable to open the device in write mode\n");
+
+    return 0;
+  }
+  if (!pxState->u8Multi)
+  {
+    printf("Wipe starting, %s\n", sADT_WipeName(u8Wipe));
+    // Write couple of newlines in sync to the prevline sequences
+    printf("\n\n");
+  }
+  pxState->u64NowDataLeftBytes = pxState->u64DevSizeBytes;
+  pxState->u64LastDataLeftBytes = pxState->u64NowDataLeftBytes;
+  pxState->u64StartDataLeftBytes = pxState->u64NowDataLeftBytes;
+  // Make initial zero print a bit earlier:
+  gettimeofday(&(pxState->xLastTime), NULL);
+  pxState->xLastTime.tv_sec -= (ADT_DC_PROGRESS_UPDATE_INTERVAL + 1);
+  gettimeofday(&(pxState->xStartTime), NULL);
+  __atomic_store_n(&(pxState->u8Phase), ADT_DC_PHASE_WRITE, __ATOMIC_RELEASE);
+
+  for (u64Offset = 0; u64Offset < pxState->u64DevSizeBytes; u64Offset += u64Bytes)
+  {
+    u64Bytes = (((pxState->u64DevSizeBytes - u64Offset) > ADT_DC_WIPE_CHUNK) ?
+		ADT_DC_WIPE_CHUNK : (pxState->u64DevSizeBytes - u64Offset));
+    u64StartNanos = u64DC_NowNanos();
+
+    if (!bADT_WipeRange(pxState->iFd, u64Offset, u64Bytes, u8Wipe, &u8Used))
+    {
+      DC_Message(pxState, "\nError: Problem wiping bytes %" PRIu64 " (%s)\n",
+		 u64Offset, strerror(errno));
+      DC_CloseDevice(pxState);
+
+      return 0;
+    }
+    DC_RecordLatency(pxState, u64StartNanos, u64Offset, u64Bytes, 1);
+    u8Zeroed = (u8Zeroed && bADT_WipeReadsZero(pxState->iFd, u8Used));
+
+    if (u8Used != u8Wipe)
+    {
+      DC_Message(pxState, "\nWipe by %s not supported, writing zeros instead\n\n\n",
+		 sADT_WipeName(u8Wipe));
+      u8Wipe = u8Used;
+    }
+    DC_CountDone(pxState, u64Bytes);
+    DC_PrintProgress(pxState, 0);
+  }
+  DC_PrintProgress(pxState, 1);
+
+  if (!u8Zeroed)
+  {
+    DC_CloseDevice(pxState);
+
+    if (!pxState->u8Multi)
+    {
+      printf("\nDone wiping (%s), data after discard is undefined, not checked!\n",
+	     sADT_WipeName(u8Wipe));
+    }
+
+    return 1;
+  }
+  if (!bADT_CheckZeroed(pxState->iFd, 0, pxState->u64DevSizeBytes, ADT_DC_WIPE_CHECKS,
+			&u64BadOffset))
+  {
+    DC_Message(pxState, "\nError: Wiped data does not read back as zeros at byte %" PRIu64 "\n",
+	       u64BadOffset);
+    DC_CloseDevice(pxState);
+
+    return 0;
+  }
+  DC_CloseDevice(pxState);
+
+  if (!pxState->u8Multi)
+  {
+    printf("\nDone wiping (%s), %u samples read back as zeros!\n",
+	   sADT_WipeName(u8Wipe), ADT_DC_WIPE_CHECKS);
+  }
+
+  return 1;
+}
+
+
+
+// Upper bound of the bad fraction of the device at the confidence.
+// None bad is the usual case and gets the exact hypergeometric bound:
+// the most bad blocks that would still go unseen often enough.
+// Otherwise Wilson score with the finite population correction.
+static double fDC_SampleBound(uint64_t u64Bad, uint64_t u64Samples, uint64_t u64Blocks)
+{
+  double fN = (double)u64Samples;
+  double fTotal = (double)u64Blocks;
+  double fP = ((double)u64Bad) / fN;
+  double fZ = 0.0;
+  double fLogMiss = 0.0;
+  uint64_t u64Low = 0;
+  uint64_t u64High = u64Blocks - u64Samples;
+  uint64_t u64Mid = 0;
+
+  if (u64Samples >= u64Blocks)
+  {
+    // Everything seen, nothing to guess
+    return fP;
+  }
+  if (u64Bad == 0)
+  {
+    while (u64Low < u64High)
+    {
+      u64Mid = u64Low + ((u64High - u64Low + 1) / 2);
+
+      // Chance that none of the samples hits any of u64Mid bad blocks
+      fLogMiss = (lgamma(fTotal - u64Mid + 1.0) - lgamma(fTotal - u64Mid - fN + 1.0) +
+		  lgamma(fTotal - fN + 1.0) - lgamma(fTotal + 1.0));
+
+      if (fLogMiss >= log(1.0 - ADT_DC_SAMPLE_CONFIDENCE))
+      {
+	u64Low = u64Mid;
+      }
+      else
+      {
+	u64High = u64Mid - 1;
+      }
+    }
+
+    return (((double)u64Low) / fTotal);
+  }
+  fZ = ADT_DC_SAMPLE_Z * sqrt((fTotal - fN) / (fTotal - 1.0));
+
+  return ((fP + ((fZ * fZ) / (2.0 * fN)) +
+	   (fZ * sqrt(((fP * (1.0 - fP)) / fN) + ((fZ * fZ) / (4.0 * fN * fN))))) /
+	  (1.0 + ((fZ * fZ) / fN)));
+}
+
+
+
+static void DC_ReportSample(tDcState* pxState, uint64_t u64Samples, uint64_t u64Blocks,
+			    uint64_t u64Unit, uint64_t u64Bad)
+{
+  double fBound = fDC_SampleBound(u64Bad, u64Samples, u64Blocks);
+  char sSizeHumReadBuf[ADT_GEN_BUF_SIZE] = { 0 };
+
+  ADT_BytesToHumanReadable(u64Unit, sSizeHumReadBuf);
+  DC_Message(pxState, "\nSampled %" PRIu64 " of %" PRIu64 " blocks of %s, %.4f%% of the device\n",
+	     u64Samples, u64Blocks, sSizeHumReadBuf, (100.0 * u64Samples) / u64Blocks);
+  ADT_BytesToHumanReadable((uint64_t)(fBound * pxState->u64DevSizeBytes), sSizeHumReadBuf);
+  DC_Message(pxState, "%" PRIu64 " bad samples, with %.0f%% confidence at most %.4f%% (%s) "
+	     "of the device is bad\n", u64Bad, 100.0 * ADT_DC_SAMPLE_CONFIDENCE,
+	     100.0 * fBound, sSizeHumReadBuf);
+}
+
+
+
+// Checks one read sample, returns 1 if it was bad
+static uint8_t bDC_CheckSample(tDcState* pxState, void* pBufMem, uint64_t u64Offset,
+			       uint64_t u64Bytes, int64_t i64ReadBytes)
+{
+  uint64_t u64BadOffset = 0;
+
+  DC_CountDone(pxState, u64Bytes);
+
+  if (i64ReadBytes != (int64_t)u64Bytes)
+  {
+    DC_AddBadExtent(pxState, u64Offset, u64Offset + u64Bytes, ADT_DC_EXTENT_READ_ERROR);
+
+    return 1;
+  }
+  u64BadOffset = u64DC_RunGenJob(pxState, ADT_DC_GEN_JOB_VERIFY, pBufMem, u64Bytes,
+				 u64Offset / ADT_DC_RUNNING_NUM_SIZE_BYTES);
+
+  if (u64BadOffset >= u64Bytes)
+  {
+    return 0;
+  }
+  if (!pxState->u8MismatchSeen)
+  {
+    pxState->u8MismatchSeen = 1;
+    pxState->u64BadOffset = u64Offset + u64BadOffset;
+  }
+  DC_AddBadExtent(pxState, u64Offset, u64Offset + u64Bytes,
+		  ADT_DC_EXTENT_MISMATCH + pxState->u8GenBadKind);
+
+  return 1;
+}
+
+
+
+// Reads io size blocks, one from a random place in each of equal
+// strata of the device, so that they spread over the whole surface.
+// Bad samples are recorded like with -c and the sampling goes on.
+static uint8_t bDC_SampleTest(tDcState* pxState)
+{
+  tAdtMem xMem;
+  uint64_t u64Unit = pxState->u32IoSize;
+  uint64_t u64Blocks = 0;
+  uint64_t u64Samples = 0;
+  uint64_t u64Next = 0;
+  uint64_t u64Done = 0;
+  uint64_t u64Bad = 0;
+  uint64_t u64Random = 0;
+  uint64_t u64Low = 0;
+  uint64_t u64High = 0;
+  uint64_t u64UserData = 0;
+  uint64_t au64Offsets[ADT_DC_MAX_QUEUE_DEPTH];
+  uint64_t au64StartNanos[ADT_DC_MAX_QUEUE_DEPTH];
+  uint32_t au32FreeSlots[ADT_DC_MAX_QUEUE_DEPTH];
+  uint32_t u32FreeSlots = 0;
+  uint32_t u32Depth = 1;
+  uint32_t u32Slot = 0;
+  int32_t i32Result = 0;
+  ssize_t iCallBytes = 0;
+  char sSizeHumReadBuf[ADT_GEN_BUF_SIZE] = { 0 };
+
+  if (pxState->u8Direct)
+  {
+    u64Unit -= (u64Unit % pxState->u32BlockSize);
+    u64Unit = ((u64Unit < pxState->u32BlockSize) ? pxState->u32BlockSize : u64Unit);
+  }
+  u64Blocks = pxState->u64DevSizeBytes / u64Unit;
+
+  if (u64Blocks == 0)
+  {
+    DC_Message(pxState, "Error: Device is smaller than one sample\n");
+
+    return 0;
+  }
+  u64Samples = (pxState->u64SampleCount ? pxState->u64SampleCount :
+		(uint64_t)ceil((pxState->fSamplePercent * u64Blocks) / 100.0));
+  u64Samples = ((u64Samples > u64Blocks) ? u64Blocks : u64Samples);
+
+  if (iDC_OpenDevice(pxState, O_RDONLY) == -1)
+  {
+    DC_Message(pxState, "Error: Unable to open the device in read mode\n");
+
+    return 0;
+  }
+  if (!pxState->u8Direct)
+  {
+    // No use reading ahead around the samples
+    DC_DropCached(pxState, 0, pxState->u64DevSizeBytes);
+    posix_fadvise(pxState->iFd, 0, 0, POSIX_FADV_RANDOM);
+  }
+  if (pxState->u8Uring)
+  {
+    // Every request in flight has a buffer of its own
+    u32Depth = pxState->u32QueueDepth;
+    u32Depth = (((u32Depth * u64Unit) > ADT_DC_MAX_SAMPLE_MEM) ?
+		(uint32_t)(ADT_DC_MAX_SAMPLE_MEM / u64Unit) : u32Depth);
+    u32Depth = ((u32Depth == 0) ? 1 : u32Depth);
+  }
+  if (!bADT_MemAlloc(&xMem, u32Depth * u64Unit, pxState->iNumaNode))
+  {
+    DC_Message(pxState, "Error: Unable to allocate sample buffers\n");
+    DC_CloseDevice(pxState);
+
+    return 0;
+  }
+  for (u32FreeSlots = 0; u32FreeSlots < u32Depth; u32FreeSlots++)
+  {
+    au32FreeSlots[u32FreeSlots] = u32FreeSlots;
+  }
+  DC_StartGenWorkers(pxState);
+  if (!pxState->u8Multi)
+  {
+    ADT_BytesToHumanReadable(u64Unit, sSizeHumReadBuf);
+    printf("Sample test starting, %" PRIu64 " samples of %s, %u in flight\n",
+	   u64Samples, sSizeHumReadBuf, u32Depth);
+    // Write couple of newlines in sync to the prevline sequences
+    printf("\n\n");
+  }
+  u64Random = u64DC_NowNanos() ^ (uint64_t)(uintptr_t)pxState;
+  pxState->u8MismatchSeen = 0;
+  pxState->u64TotalBytes = u64Samples * u64Unit;
+  pxState->u64NowDataLeftBytes = pxState->u64TotalBytes;
+  pxState->u64LastDataLeftBytes = pxState->u64NowDataLeftBytes;
+  pxState->u64StartDataLeftBytes = pxState->u64NowDataLeftBytes;
+  // Make initial zero print a bit earlier:
+  gettimeofday(&(pxState->xLastTime), NULL);
+  pxState->xLastTime.tv_sec -= (ADT_DC_PROGRESS_UPDATE_INTERVAL + 1);
+  gettimeofday(&(pxState->xStartTime), NULL);
+  __atomic_store_n(&(pxState->u8Phase), ADT_DC_PHASE_READ, __ATOMIC_RELEASE);
+
+  while (u64Done < u64Samples)
+  {
+    while ((u64Next < u64Samples) && (u32FreeSlots > 0))
+    {
+      // Xorshift is plenty for picking places
+      u64Random ^= u64Random << 13;
+      u64Random ^= u64Random >> 7;
+      u64Random ^= u64Random << 17;
+      // Product does not fit 64 bits with small units on big disks
+      u64Low = (uint64_t)(((unsigned __int128)u64Next * u64Blocks) / u64Samples);
+      u64High = (uint64_t)(((unsigned __int128)(u64Next + 1) * u64Blocks) / u64Samples);
+      u32Slot = au32FreeSlots[--u32FreeSlots];
+      au64Offsets[u32Slot] = (u64Low + (u64Random % (u64High - u64Low))) * u64Unit;
+      au64StartNanos[u32Slot] = u64DC_NowNanos();
+
+      if (!pxState->u8Uring)
+      {
+	iCallBytes = pread(pxState->iFd, xMem.pMem + (u32Slot * u64Unit), u64Unit,
+			   au64Offsets[u32Slot]);
+	DC_RecordLatency(pxState, au64StartNanos[u32Slot], au64Offsets[u32Slot], u64Unit, 0);
+	DC_ForgetRead(pxState, au64Offsets[u32Slot], u64Unit);
+	u64Bad += bDC_CheckSample(pxState, xMem.pMem + (u32Slot * u64Unit),
+				  au64Offsets[u32Slot], u64Unit, iCallBytes);
+	au32FreeSlots[u32FreeSlots++] = u32Slot;
+	u64Done++;
+      }
+      else if (!bADT_UringQueueRw(&(pxState->xUring), pxState->iFd,
+				  xMem.pMem + (u32Slot * u64Unit), (uint32_t)u64Unit,
+				  au64Offsets[u32Slot], 0, u32Slot))
+      {
+	au32FreeSlots[u32FreeSlots++] = u32Slot;
+
+	break;
+      }
+      u64Next++;
+    }
+    if (pxState->u8Uring)
+    {
+      if (iADT_UringSubmit(&(pxState->xUring), 1) < 0)
+      {
+	// Buffers are freed below, kernel must be done with them
+	ADT_UringDrain(&(pxState->xUring), u32Depth - u32FreeSlots);
+	DC_Message(pxState, "\nError: io_uring failed while sampling\n");
+
+	break;
+      }
+      while (bADT_UringReap(&(pxState->xUring), &u64UserData, &i32Result))
+      {
+	u32Slot = (uint32_t)u64UserData;
+	DC_RecordLatency(pxState, au64StartNanos[u32Slot], au64Offsets[u32Slot], u64Unit, 0);
+	DC_ForgetRead(pxState, au64Offsets[u32Slot], u64Unit);
+	u64Bad += bDC_CheckSample(pxState, xMem.pMem + (u32Slot * u64Unit),
+				  au64Offsets[u32Slot], u64Unit, i32Result);
+	au32FreeSlots[u32FreeSlots++] = u32Slot;
+	u64Done++;
+      }
+    }
+    DC_PrintProgress(pxState, 0);
+  }
+  DC_StopGenWorkers(pxState);
+  DC_CloseDevice(pxState);
+  ADT_MemFree(&xMem);
+
+  if (u64Done < u64Samples)
   {
-    // Fix the 5 seconds stuff
-    pxState->xNowTime.tv_sec += 5;
+    return 0;
+  }
+  DC_PrintProgress(pxState, 1);
+  DC_ReportSample(pxState, u64Samples, u64Blocks, u64Unit, u64Bad);
 
-    // Calculate needed variables
-    u32TimeElapsed = pxState->xNowTime.tv_sec - pxState->xStartTime.tv_sec;
-    u32Secs = u32TimeElapsed % 60;
-    u32TimeElapsed -= u32Secs;
-    u32Mins = (u32TimeElapsed % 3600) / 60;
-    u32TimeElapsed -= u32Mins * 60;
-    u32Hours = u32TimeElapsed / 3600;
-    u64PassedBytes = pxState->u64DevSizeBytes - pxState->u64NowDataLeftBytes;
-    fProgress = 100.0 * (1.0 * u64PassedBytes) / (1.0 * pxState->u64DevSizeBytes);
-    
+  if (pxState->u8Multi)
+  {
+    // Main thread reports for all devices
+    return 1;
+  }
+  printf("\nDone sampling, %s\n", (u64Bad ? "bad samples found!" : "compare OK!"));
+
+  return 1;
+}
+
+
+
+// Whole test of one device, own thread when there are many
+static void* pDC_DeviceThread(void* pParams)
+{
+  tDcState* pxState = (tDcState*)pParams;
+
+  // Stripes are checkpointed by their device
+  uint8_t u8Checkpoint = ((pxState->sStateFile[0] != 0) && (pxState->pxParent == NULL));
+
+  pxState->u8Result = 1;
+
+  if (pxState->u8Sample)
+  {
+    pxState->u8Result = bDC_SampleTest(pxState);
+  }
+  else if (pxState->u8Wipe)
+  {
+    pxState->u8Result = bDC_WipeDevice(pxState);
+  }
+  else if (pxState->u8Combined)
+  {
+    pxState->u8Result = bDC_CombinedTest(pxState);
+  }
+  else if (pxState->u8Write)
+  {
+    if (u8Checkpoint && (pxState->u8ResumePhase != ADT_DC_PHASE_WRITE))
+    {
+      DC_SavePhaseStart(pxState, ADT_DC_PHASE_WRITE);
+    }
+    if (!bDC_WriteTest(pxState))
+    {
+      pxState->u8Result = 0;
+    }
+    else if (u8Checkpoint)
+    {
+      // Read may come later with -r --resume
+      DC_SavePhaseStart(pxState, ADT_DC_PHASE_READ);
+    }
+  }
+  if (pxState->u8Read && pxState->u8Result && (!pxState->u8Combined) && (!pxState->u8Sample))
+  {
+    if (u8Checkpoint && (!pxState->u8Write) && (pxState->u8ResumePhase != ADT_DC_PHASE_READ))
+    {
+      DC_SavePhaseStart(pxState, ADT_DC_PHASE_READ);
+    }
+    if (!bDC_ReadTest(pxState))
+    {
+      pxState->u8Result = 0;
+    }
+    else if (u8Checkpoint)
+    {
+      // All done, nothing to resume anymore
+      unlink(pxState->sStateFile);
+    }
+  }
+  __atomic_store_n(&(pxState->u8Phase),
+		   (pxState->u8Result ? ADT_DC_PHASE_DONE : ADT_DC_PHASE_FAILED), __ATOMIC_RELEASE);
+
+  if ((!pxState->u8Result) && (pxState->pxParent != NULL))
+  {
+    // No point going on with the other stripes
+    pxState->pxParent->u8StripeFailed = 1;
+  }
+
+  return NULL;
+}
+
+
+
+// Child runs one phase over a part of the device, with nothing open
+// yet. Copy of the device state is expected to be there already.
+static void DC_InitChild(tDcState* pxChild, tDcState* pxState, tDcPool* pxPool, uint8_t u8Write)
+{
+  pxChild->pxParent = pxState;
+  pxChild->pxPool = pxPool;
+  pxChild->u8Write = u8Write;
+  pxChild->u8Read = !u8Write;
+  pxChild->u8Combined = 0;
+  pxChild->u8Multi = 1;
+  __atomic_store_n(&(pxChild->u8Phase), ADT_DC_PHASE_IDLE, __ATOMIC_RELEASE);
+  pxChild->iFd = -1;
+  pxChild->pi32UringResults = NULL;
+  pxChild->pu64UringStartNanos = NULL;
+  pxChild->pxBufs = NULL;
+  pxChild->pxGenWorkers = NULL;
+  pxChild->pxExtents = NULL;
+  pxChild->u32ExtentCount = 0;
+  pxChild->u32ExtentCapacity = 0;
+}
+
+
+
+// Splits the device into stripes, each tested in its own thread
+// with its own descriptor and positional I/O. Running numbers come
+// from the offset, so every stripe knows where it starts from.
+static uint8_t bDC_StripedTest(tDcState* pxState, uint8_t u8Write)
+{
+  tDcState* pxStripes = NULL;
+  tDcPool xPool;
+  tDcPool* pxPool = pxState->pxPool;
+  uint64_t u64StripeBytes = 0;
+  uint64_t au64Offsets[ADT_DC_MAX_STRIPES];
+  uint32_t u32Stripes = 0;
+  uint32_t u32Started = 0;
+  uint32_t i;
+  uint8_t u8Phase = (u8Write ? ADT_DC_PHASE_WRITE : ADT_DC_PHASE_READ);
+  uint8_t u8StripePhase = 0;
+  uint8_t u8Running = 1;
+  uint8_t u8Result = 1;
+  struct timeval xCheckpointTime;
+  struct timeval xNowTime;
+
+  u64StripeBytes = u64DC_StripeBytes(pxState, &u32Stripes);
+  pxStripes = calloc(u32Stripes, sizeof(tDcState));
+
+  if (pxStripes == NULL)
+  {
+    DC_Message(pxState, "Error: Malloc failed\n");
+
+    return 0;
+  }
+  if (pxPool == NULL)
+  {
+    if (!bDC_PoolInit(&xPool, pxState))
+    {
+      DC_Message(pxState, "Error: Unable to allocate %u buffers\n", pxState->u32BufCount);
+      free(pxStripes);
+
+      return 0;
+    }
+    pxPool = &xPool;
+  }
+  if (!pxState->u8Multi)
+  {
+    printf("%s test starting, %u stripes\n", (u8Write ? "Write" : "Read"), u32Stripes);
+    // Write couple of newlines in sync to the prevline sequences
+    printf("\n\n");
+  }
+  pxState->u8MismatchSeen = 0;
+  pxState->u8StripeFailed = 0;
+  pxState->u64NowDataLeftBytes = 0;
+
+  for (i = 0; i < u32Stripes; i++)
+  {
+    // Stripe is the device cut short, resumed ones even shorter
+    memcpy(&(pxStripes[i]), pxState, sizeof(tDcState));
+    pxStripes[i].u64RegionBegin = u64DC_StartOffset(pxState, u8Phase, i, i * u64StripeBytes);
+    pxStripes[i].u64RegionEnd = (((i + 1) == u32Stripes) ?
+				 pxState->u64DevSizeBytes : ((i + 1) * u64StripeBytes));
+    pxStripes[i].u64DurableOffset = pxStripes[i].u64RegionBegin;
+    pxState->u64NowDataLeftBytes += pxStripes[i].u64RegionEnd - pxStripes[i].u64RegionBegin;
+  }
+  pxState->u64LastDataLeftBytes = pxState->u64NowDataLeftBytes;
+  pxState->u64StartDataLeftBytes = pxState->u64NowDataLeftBytes;
+  // Make initial zero print a bit earlier:
+  gettimeofday(&(pxState->xLastTime), NULL);
+  pxState->xLastTime.tv_sec -= (ADT_DC_PROGRESS_UPDATE_INTERVAL + 1);
+  gettimeofday(&(pxState->xStartTime), NULL);
+  xCheckpointTime = pxState->xStartTime;
+  __atomic_store_n(&(pxState->u8Phase), u8Phase, __ATOMIC_RELEASE);
+
+  for (i = 0; i < u32Stripes; i++)
+  {
+    DC_InitChild(&(pxStripes[i]), pxState, pxPool, u8Write);
+
+    if (pthread_create(&(pxStripes[i].xDeviceThread), NULL,
+		       pDC_DeviceThread, &(pxStripes[i])) != 0)
+    {
+      DC_Message(pxState, "Error: Unable to start stripe thread\n");
+      u8Result = 0;
+
+      break;
+    }
+    u32Started++;
+  }
+  while (u8Running)
+  {
+    u8Running = 0;
+
+    for (i = 0; i < u32Started; i++)
+    {
+      u8StripePhase = __atomic_load_n(&(pxStripes[i].u8Phase), __ATOMIC_ACQUIRE);
+
+      if ((u8StripePhase != ADT_DC_PHASE_DONE) && (u8StripePhase != ADT_DC_PHASE_FAILED))
+      {
+	u8Running = 1;
+      }
+    }
+    if (u8Running)
+    {
+      sleep(1);
+    }
+    if (u8Running && (!pxState->u8StripeFailed))
+    {
+      DC_PrintProgress(pxState, 0);
+    }
+    gettimeofday(&xNowTime, NULL);
+
+    if ((pxState->sStateFile[0] != 0) && (u32Started == u32Stripes) && u8Running &&
+	(xNowTime.tv_sec >= (xCheckpointTime.tv_sec + ADT_DC_CHECKPOINT_INTERVAL)))
+    {
+      // Stripes publish what they have made durable, save them together
+      for (i = 0; i < u32Stripes; i++)
+      {
+	au64Offsets[i] = __atomic_load_n(&(pxStripes[i].u64DurableOffset), __ATOMIC_ACQUIRE);
+      }
+      DC_SaveCheckpoint(pxState, u8Phase, au64Offsets, u32Stripes);
+      xCheckpointTime = xNowTime;
+    }
+  }
+  for (i = 0; i < u32Started; i++)
+  {
+    pthread_join(pxStripes[i].xDeviceThread, NULL);
+
+    if (!pxStripes[i].u8Result)
+    {
+      u8Result = 0;
+    }
+    // Stripes are in device order, first mismatch is in the first one having it
+    if (pxStripes[i].u8MismatchSeen && (!pxState->u8MismatchSeen))
+    {
+      pxState->u8MismatchSeen = 1;
+      pxState->u64BadOffset = pxStripes[i].u64BadOffset;
+      pxState->u64BadExpected = pxStripes[i].u64BadExpected;
+      pxState->u64BadActual = pxStripes[i].u64BadActual;
+      pxState->u8BadKind = pxStripes[i].u8BadKind;
+    }
+  }
+  if (pxPool == &xPool)
+  {
+    DC_PoolDestroy(&xPool);
+  }
+  free(pxStripes);
+
+  if (!u8Result)
+  {
+    return 0;
+  }
+  DC_PrintProgress(pxState, 1);
+
+  if (pxState->u8Multi)
+  {
+    return 1;
+  }
+  if (u8Write)
+  {
+    printf("\nDone all writing!\n");
+  }
+  else if (pxState->u32ExtentCount > 0)
+  {
+    printf("\nDone all reading, bad extents found!\n");
+  }
+  else
+  {
+    printf("\nDone all reading, compare OK!\n");
+  }
+
+  return 1;
+}
+
+
+
+// Writer and reader run at the same time, the reader a lag behind
+// and flushing what it reads from the cache first. Errors show up
+// as soon as the reader gets there, not after a full write pass.
+static uint8_t bDC_CombinedTest(tDcState* pxState)
+{
+  tDcState* pxChildren = NULL;
+  tDcPool xPool;
+  tDcPool* pxPool = pxState->pxPool;
+  uint32_t i;
+  uint32_t u32Started = 0;
+  uint8_t u8Result = 1;
+  char sSizeHumReadBuf[ADT_GEN_BUF_SIZE] = { 0 };
+
+  pxChildren = calloc(2, sizeof(tDcState));
+
+  if (pxChildren == NULL)
+  {
+    DC_Message(pxState, "Error: Malloc failed\n");
+
+    return 0;
+  }
+  if (pxPool == NULL)
+  {
+    if (!bDC_PoolInit(&xPool, pxState))
+    {
+      DC_Message(pxState, "Error: Unable to allocate %u buffers\n", pxState->u32BufCount);
+      free(pxChildren);
+
+      return 0;
+    }
+    pxPool = &xPool;
+  }
+  if (!pxState->u8Multi)
+  {
+    ADT_BytesToHumanReadable(pxState->u64VerifyLagBytes, sSizeHumReadBuf);
+    printf("Write and read test starting, reading %s behind\n", sSizeHumReadBuf);
+    // Write couple of newlines in sync to the prevline sequences
+    printf("\n\n");
+  }
+  pxState->u8MismatchSeen = 0;
+  pxState->u8StripeFailed = 0;
+  pxState->u64NowDataLeftBytes = pxState->u64DevSizeBytes;
+  pxState->u64LastDataLeftBytes = pxState->u64NowDataLeftBytes;
+  pxState->u64StartDataLeftBytes = pxState->u64NowDataLeftBytes;
+  // Make initial zero print a bit earlier:
+  gettimeofday(&(pxState->xLastTime), NULL);
+  pxState->xLastTime.tv_sec -= (ADT_DC_PROGRESS_UPDATE_INTERVAL + 1);
+  gettimeofday(&(pxState->xStartTime), NULL);
+  __atomic_store_n(&(pxState->u8Phase), ADT_DC_PHASE_COMBINED, __ATOMIC_RELEASE);
+
+  for (i = 0; i < 2; i++)
+  {
+    memcpy(&(pxChildren[i]), pxState, sizeof(tDcState));
+    DC_InitChild(&(pxChildren[i]), pxState, pxPool, (i == 0));
+    pxChildren[i].u64WrittenOffset = 0;
+  }
+  // Second one reads after the first
+  pxChildren[1].pxLeader = &(pxChildren[0]);
+
+  for (i = 0; i < 2; i++)
+  {
+    if (pthread_create(&(pxChildren[i].xDeviceThread), NULL,
+		       pDC_DeviceThread, &(pxChildren[i])) != 0)
+    {
+      DC_Message(pxState, "Error: Unable to start test thread\n");
+      pxState->u8StripeFailed = 1;
+      u8Result = 0;
+
+      break;
+    }
+    u32Started++;
+  }
+  while ((u32Started == 2) &&
+	 (__atomic_load_n(&(pxChildren[1].u8Phase), __ATOMIC_ACQUIRE) != ADT_DC_PHASE_DONE) &&
+	 (__atomic_load_n(&(pxChildren[1].u8Phase), __ATOMIC_ACQUIRE) != ADT_DC_PHASE_FAILED))
+  {
+    sleep(1);
+
+    if (!pxState->u8StripeFailed)
+    {
+      DC_PrintProgress(pxState, 0);
+    }
+  }
+  for (i = 0; i < u32Started; i++)
+  {
+    pthread_join(pxChildren[i].xDeviceThread, NULL);
+
+    if (!pxChildren[i].u8Result)
+    {
+      u8Result = 0;
+    }
+  }
+  if (pxChildren[1].u8MismatchSeen)
+  {
+    pxState->u8MismatchSeen = 1;
+    pxState->u64BadOffset = pxChildren[1].u64BadOffset;
+    pxState->u64BadExpected = pxChildren[1].u64BadExpected;
+    pxState->u64BadActual = pxChildren[1].u64BadActual;
+    pxState->u8BadKind = pxChildren[1].u8BadKind;
+  }
+  if (pxPool == &xPool)
+  {
+    DC_PoolDestroy(&xPool);
+  }
+  free(pxChildren);
+
+  if (!u8Result)
+  {
+    return 0;
+  }
+  DC_PrintProgress(pxState, 1);
+
+  if (pxState->u8Multi)
+  {
+    return 1;
+  }
+  if (pxState->u32ExtentCount > 0)
+  {
+    printf("\nDone all writing and reading, bad extents found!\n");
+  }
+  else
+  {
+    printf("\nDone all writing and reading, compare OK!\n");
+  }
+
+  return 1;
+}
+
+
+
+// One line per device and the total. Speeds are since the previous
+// print, each device thread only ever touches its own counters.
+static void DC_PrintMultiProgress(tDcState** ppxStates, uint32_t u32Count,
+				  struct timeval* pxRunStartTime, uint8_t u8Redraw)
+{
+  tDcState* pxState = NULL;
+  struct timeval xNowTime;
+  uint32_t i;
+  uint32_t u32TimeElapsed = 0;
+  uint8_t u8Phase = 0;
+  uint64_t u64LeftBytes = 0;
+  float fTimeElapsedFine = 0.0;
+  float fProgress = 0.0;
+  float fNowSpeedMbPerSeconds = 0.0;
+  float fAverageSpeedMbPerSeconds = 0.0;
+  float fTotalSpeedMbPerSeconds = 0.0;
+
+  gettimeofday(&xNowTime, NULL);
+
+  if (u8Redraw)
+  {
+    printf("\x1b[%uA", u32Count + 1);
+  }
+  for (i = 0; i < u32Count; i++)
+  {
+    pxState = ppxStates[i];
+    u8Phase = __atomic_load_n(&(pxState->u8Phase), __ATOMIC_ACQUIRE);
+    u64LeftBytes = pxState->u64NowDataLeftBytes;
     fNowSpeedMbPerSeconds = 0.0;
     fAverageSpeedMbPerSeconds = 0.0;
-    
-    // First calculate current speed
-    fTimeElapsedFine = (1.0 * (pxState->xNowTime.tv_sec - pxState->xLastTime.tv_sec)) +
-      (0.000001 * (pxState->xNowTime.tv_usec - pxState->xLastTime.tv_usec));
-    fNowSpeedMbPerSeconds = (1.0 * (pxState->u64LastDataLeftBytes - pxState->u64NowDataLeftBytes)) /
-      ((1.0 * ADT_BYTES_IN_MEBIBYTE) * fTimeElapsedFine);
-    // And now we calculate average speed
-    fTimeElapsedFine = (1.0 * (pxState->xNowTime.tv_sec - pxState->xStartTime.tv_sec)) +
-      (0.000001 * (pxState->xNowTime.tv_usec - pxState->xStartTime.tv_usec));
-    fAverageSpeedMbPerSeconds = (1.0 * (pxState->u64DevSizeBytes - pxState->u64NowDataLeftBytes)) /
-      ((1.0 * ADT_BYTES_IN_MEBIBYTE) * fTimeElapsedFine);
 
-    printf("\x1b[A" "\x1b[A" "\r%" PRIu64 "/%" PRIu64 " bytes, %02.2f%% done. \n"
-	   "%uh %02um %02us elapsed. \n"
-	   "Speed now: %.2f MiB/s  Average: %.2f MiB/s       ",
-	   u64PassedBytes, pxState->u64DevSizeBytes, fProgress,
-	   u32Hours, u32Mins, u32Secs, fNowSpeedMbPerSeconds, fAverageSpeedMbPerSeconds);
-    fflush(stdout);
+    if (u8Phase != pxState->u8ShownPhase)
+    {
+      // New test begun since the last print, count from its start
+      pxState->u8ShownPhase = u8Phase;
+      pxState->xShownTime = pxState->xStartTime;
+      pxState->u64ShownDataLeftBytes = pxState->u64StartDataLeftBytes;
+    }
+    if ((u8Phase == ADT_DC_PHASE_WRITE) || (u8Phase == ADT_DC_PHASE_READ) ||
+	(u8Phase == ADT_DC_PHASE_COMBINED))
+    {
+      fTimeElapsedFine = (1.0 * (xNowTime.tv_sec - pxState->xShownTime.tv_sec)) +
+	(0.000001 * (xNowTime.tv_usec - pxState->xShownTime.tv_usec));
 
-    // Now that this has been resolved, make current accounting values old values
-    pxState->xLastTime = pxState->xNowTime;
-    pxState->u64LastDataLeftBytes = pxState->u64NowDataLeftBytes;
+      if (fTimeElapsedFine > 0.0)
+      {
+	fNowSpeedMbPerSeconds = (1.0 * (pxState->u64ShownDataLeftBytes - u64LeftBytes)) /
+	  ((1.0 * ADT_BYTES_IN_MEBIBYTE) * fTimeElapsedFine);
+      }
+      fTimeElapsedFine = (1.0 * (xNowTime.tv_sec - pxState->xStartTime.tv_sec)) +
+	(0.000001 * (xNowTime.tv_usec - pxState->xStartTime.tv_usec));
+
+      if (fTimeElapsedFine > 0.0)
+      {
+	fAverageSpeedMbPerSeconds = (1.0 * (pxState->u64StartDataLeftBytes - u64LeftBytes)) /
+	  ((1.0 * ADT_BYTES_IN_MEBIBYTE) * fTimeElapsedFine);
+      }
+      fTotalSpeedMbPerSeconds += fNowSpeedMbPerSeconds;
+    }
+    fProgress = ((u8Phase == ADT_DC_PHASE_IDLE) ? 0.0 :
+		 ((u8Phase == ADT_DC_PHASE_DONE) ? 100.0 :
+		  (100.0 * (1.0 * (pxState->u64TotalBytes - u64LeftBytes)) /
+		   (1.0 * pxState->u64TotalBytes))));
+
+    printf("\r%s  %-6s %6.2f%% done  Speed now: %.2f MiB/s  Average: %.2f MiB/s  Bad extents: %u       \n",
+	   pxState->sDevice, asDcPhaseNames[u8Phase], fProgress,
+	   fNowSpeedMbPerSeconds, fAverageSpeedMbPerSeconds, pxState->u32ExtentCount);
+
+    pxState->xShownTime = xNowTime;
+    pxState->u64ShownDataLeftBytes = u64LeftBytes;
   }
+  u32TimeElapsed = xNowTime.tv_sec - pxRunStartTime->tv_sec;
+  printf("\rTotal speed now: %.2f MiB/s  %uh %02um %02us elapsed.       \n",
+	 fTotalSpeedMbPerSeconds, u32TimeElapsed / 3600, (u32TimeElapsed % 3600) / 60,
+	 u32TimeElapsed % 60);
+  fflush(stdout);
 }
 
 
 
+// Runs all devices in parallel, buffers from a common pool
+static void DC_RunMultiTest(tDcState* pxTemplate, tDcState** ppxStates)
+{
+  tDcPool xPool;
+  struct timeval xRunStartTime;
+  uint32_t i;
+  uint32_t u32Ticks = 0;
+  uint32_t u32ShownMessages = 0;
+  uint8_t u8Phase = 0;
+  uint8_t u8Running = 1;
+
+  if (!bDC_PoolInit(&xPool, pxTemplate))
+  {
+    printf("Error: Unable to allocate %u shared buffers\n", pxTemplate->u32BufCount);
+
+    return;
+  }
+  printf("Testing %u devices, %u shared buffers of %u bytes\n",
+	 pxTemplate->u32DeviceCount, pxTemplate->u32BufCount, pxTemplate->u32BufSize);
+  gettimeofday(&xRunStartTime, NULL);
+
+  for (i = 0; i < pxTemplate->u32DeviceCount; i++)
+  {
+    ppxStates[i]->pxPool = &xPool;
+
+    if (pthread_create(&(ppxStates[i]->xDeviceThread), NULL,
+		       pDC_DeviceThread, ppxStates[i]) != 0)
+    {
+      printf("Error: Unable to start test thread for %s\n", ppxStates[i]->sDevice);
+      __atomic_store_n(&(ppxStates[i]->u8Phase), ADT_DC_PHASE_FAILED, __ATOMIC_RELEASE);
+      ppxStates[i]->pxPool = NULL;
+    }
+  }
+  DC_PrintMultiProgress(ppxStates, pxTemplate->u32DeviceCount, &xRunStartTime, 0);
+  u32ShownMessages = __atomic_load_n(&u32DcMessages, __ATOMIC_RELAXED);
 
-static uint8_t bDC_BufferAllocator(void* pParams)
-{
-  uint8_t u8RetVal = 0;
-  tDcState* pxState = (tDcState*)pParams;
-  
-  while (1)
+  while (u8Running)
   {
-    sem_wait(&(pxState->xSemThread));
+    sleep(1);
+    u32Ticks++;
+    u8Running = 0;
 
-    if (pxState->u8WantBuffer == 0)
+    for (i = 0; i < pxTemplate->u32DeviceCount; i++)
     {
-      DC_PrepareBuffer(pxState, pxState->apMemBufs[0]);
-      sem_post(&(pxState->xSemBuffer0));
+      u8Phase = __atomic_load_n(&(ppxStates[i]->u8Phase), __ATOMIC_ACQUIRE);
+
+      if ((u8Phase != ADT_DC_PHASE_DONE) && (u8Phase != ADT_DC_PHASE_FAILED))
+      {
+	u8Running = 1;
+      }
     }
-    else if (pxState->u8WantBuffer == 1)
+    if ((!u8Running) || ((u32Ticks % ADT_DC_PROGRESS_UPDATE_INTERVAL) == 0))
     {
-      DC_PrepareBuffer(pxState, pxState->apMemBufs[1]);
-      sem_post(&(pxState->xSemBuffer1));
+      // Lines printed by devices would get overdrawn, start below them
+      DC_PrintMultiProgress(ppxStates, pxTemplate->u32DeviceCount, &xRunStartTime,
+			    (u32ShownMessages == __atomic_load_n(&u32DcMessages, __ATOMIC_RELAXED)));
+      u32ShownMessages = __atomic_load_n(&u32DcMessages, __ATOMIC_RELAXED);
     }
-    else
+  }
+  for (i = 0; i < pxTemplate->u32DeviceCount; i++)
+  {
+    if (ppxStates[i]->pxPool != NULL)
     {
-      u8RetVal = 0;
-      pthread_exit(&u8RetVal);
+      pthread_join(ppxStates[i]->xDeviceThread, NULL);
     }
   }
-
-  return 1;
+  DC_PoolDestroy(&xPool);
 }
 
 
 
-static uint8_t bDC_WriteTest(tDcState* pxState)
+// One sample line per device. Speed now is since the previous sample.
+static void DC_StreamSample(tDcStreamer* pxStreamer)
 {
-  uint64_t u64WrittenCallBytes = 0;
-  uint64_t u64FullBuffersToWrite = 0;
-  uint64_t u64LeftoverBytesToWrite = 0;
-  uint64_t u64WriteBufferNum = 0;
-  pxState->iFd = -1;
+  tDcState* pxState = NULL;
+  struct timeval xNowTime;
+  uint32_t i;
+  uint8_t u8Phase = 0;
+  uint64_t u64LeftBytes = 0;
+  float fTime = 0.0;
+  float fTimeElapsedFine = 0.0;
+  float fNowSpeedMbPerSeconds = 0.0;
+  float fAverageSpeedMbPerSeconds = 0.0;
+  const char* sChar = NULL;
 
-  if ((sem_init(&(pxState->xSemThread), 0, 0) != 0) ||
-      (sem_init(&(pxState->xSemBuffer0), 0, 0) != 0) ||
-      (sem_init(&(pxState->xSemBuffer1), 0, 0) != 0))
+  gettimeofday(&xNowTime, NULL);
+  fTime = (1.0 * (xNowTime.tv_sec - pxStreamer->xStartTime.tv_sec)) +
+    (0.000001 * (xNowTime.tv_usec - pxStreamer->xStartTime.tv_usec));
+
+  for (i = 0; i < pxStreamer->u32Count; i++)
   {
-    printf("Failed to initialize semaphores\n");
+    pxState = pxStreamer->ppxStates[i];
+    u8Phase = __atomic_load_n(&(pxState->u8Phase), __ATOMIC_ACQUIRE);
+    u64LeftBytes = __atomic_load_n(&(pxState->u64NowDataLeftBytes), __ATOMIC_RELAXED);
 
-    return 1;
+    if (u8Phase == ADT_DC_PHASE_IDLE)
+    {
+      // Counters not set up yet
+      u64LeftBytes = pxState->u64TotalBytes;
+    }
+    fNowSpeedMbPerSeconds = 0.0;
+    fAverageSpeedMbPerSeconds = 0.0;
+
+    if (u8Phase != pxStreamer->pu8LastPhases[i])
+    {
+      // New test begun since the last sample, count from its start
+      pxStreamer->pu8LastPhases[i] = u8Phase;
+      pxStreamer->pxLastTimes[i] = pxState->xStartTime;
+      pxStreamer->pu64LastLeftBytes[i] = pxState->u64StartDataLeftBytes;
+    }
+    if ((u8Phase == ADT_DC_PHASE_WRITE) || (u8Phase == ADT_DC_PHASE_READ) ||
+	(u8Phase == ADT_DC_PHASE_COMBINED))
+    {
+      fTimeElapsedFine = (1.0 * (xNowTime.tv_sec - pxStreamer->pxLastTimes[i].tv_sec)) +
+	(0.000001 * (xNowTime.tv_usec - pxStreamer->pxLastTimes[i].tv_usec));
+
+      if (fTimeElapsedFine > 0.0)
+      {
+	fNowSpeedMbPerSeconds = (1.0 * (pxStreamer->pu64LastLeftBytes[i] - u64LeftBytes)) /
+	  ((1.0 * ADT_BYTES_IN_MEBIBYTE) * fTimeElapsedFine);
+      }
+      fTimeElapsedFine = (1.0 * (xNowTime.tv_sec - pxState->xStartTime.tv_sec)) +
+	(0.000001 * (xNowTime.tv_usec - pxState->xStartTime.tv_usec));
+
+      if (fTimeElapsedFine > 0.0)
+      {
+	fAverageSpeedMbPerSeconds = (1.0 * (pxState->u64StartDataLeftBytes - u64LeftBytes)) /
+	  ((1.0 * ADT_BYTES_IN_MEBIBYTE) * fTimeElapsedFine);
+      }
+    }
+    pxStreamer->pxLastTimes[i] = xNowTime;
+    pxStreamer->pu64LastLeftBytes[i] = u64LeftBytes;
+
+    if (pxStreamer->u8Format == ADT_DC_STREAM_CSV)
+    {
+      fprintf(pxStreamer->pxFile, "%.3f,%s,%s,%" PRIu64 ",%" PRIu64 ",%.2f,%.2f,%u,%u,%u,%u\n",
+	      fTime, pxState->sDevice, asDcPhaseNames[u8Phase],
+	      pxState->u64TotalBytes - u64LeftBytes, pxState->u64TotalBytes,
+	      fNowSpeedMbPerSeconds, fAverageSpeedMbPerSeconds, pxState->u32ExtentCount,
+	      pxState->au32ErrorCounts[ADT_DC_EXTENT_WRITE_ERROR],
+	      pxState->au32ErrorCounts[ADT_DC_EXTENT_READ_ERROR],
+	      pxState->au32ErrorCounts[ADT_DC_EXTENT_MISMATCH]);
+    }
+    else
+    {
+      fprintf(pxStreamer->pxFile, "{\"t\":%.3f,\"device\":\"", fTime);
+
+      for (sChar = pxState->sDevice; *sChar != 0; sChar++)
+      {
+	if ((*sChar == '"') || (*sChar == '\\'))
+	{
+	  fputc('\\', pxStreamer->pxFile);
+	}
+	fputc(*sChar, pxStreamer->pxFile);
+      }
+      fprintf(pxStreamer->pxFile, "\",\"phase\":\"%s\","
+	      "\"bytes_done\":%" PRIu64 ",\"bytes_total\":%" PRIu64 ","
+	      "\"mibps_now\":%.2f,\"mibps_avg\":%.2f,\"bad_extents\":%u,"
+	      "\"write_errors\":%u,\"read_errors\":%u,\"mismatches\":%u}\n",
+	      asDcPhaseNames[u8Phase],
+	      pxState->u64TotalBytes - u64LeftBytes, pxState->u64TotalBytes,
+	      fNowSpeedMbPerSeconds, fAverageSpeedMbPerSeconds, pxState->u32ExtentCount,
+	      pxState->au32ErrorCounts[ADT_DC_EXTENT_WRITE_ERROR],
+	      pxState->au32ErrorCounts[ADT_DC_EXTENT_READ_ERROR],
+	      pxState->au32ErrorCounts[ADT_DC_EXTENT_MISMATCH]);
+    }
   }
+  fflush(pxStreamer->pxFile);
+}
 
-  pthread_create(&(pxState->xAllocatorThread), NULL,
-		 (void*)bDC_BufferAllocator, pxState);
 
-  // Need to allocate both buffers
-  pxState->apMemBufs[0] = malloc(pxState->u32BufSize);
-  pxState->apMemBufs[1] = malloc(pxState->u32BufSize);
 
-  if ((pxState->apMemBufs[0] == NULL) ||
-      (pxState->apMemBufs[1] == NULL))
+static void* pDC_Streamer(void* pParams)
+{
+  tDcStreamer* pxStreamer = (tDcStreamer*)pParams;
+  struct timespec xInterval;
+
+  xInterval.tv_sec = pxStreamer->u32IntervalMs / 1000;
+  xInterval.tv_nsec = (pxStreamer->u32IntervalMs % 1000) * 1000000;
+
+  while (!__atomic_load_n(&(pxStreamer->u8Exit), __ATOMIC_ACQUIRE))
   {
-    printf("Error: Malloc failed\n");
-    free(pxState->apMemBufs[0]);
-    free(pxState->apMemBufs[1]);
-    sem_destroy(&(pxState->xSemThread));
-    sem_destroy(&(pxState->xSemBuffer0));
-    sem_destroy(&(pxState->xSemBuffer1));
-    
-    return 0;
+    DC_StreamSample(pxStreamer);
+    nanosleep(&xInterval, NULL);
   }
-  // Now it is time to set counters
-  pxState->u64CurrNumber = 0;
-  pxState->u64LastDataLeftBytes = pxState->u64DevSizeBytes;
-  pxState->u64NowDataLeftBytes = pxState->u64DevSizeBytes;
+  // Final state of everything
+  DC_StreamSample(pxStreamer);
 
-  // Thread is now waiting instructions
-  pxState->u8WantBuffer = 0;
-  // We wake another thread and sleep ourselves
-  sem_post(&(pxState->xSemThread));
-  sem_wait(&(pxState->xSemBuffer0));
-  // Ok, allocator thread has allocated buf 0.
-  // In order for the writer loop
-  // to work as expected, buffer sem needs additional post.
-  sem_post(&(pxState->xSemBuffer0));
+  return NULL;
+}
 
-  // Figure out how many full buffers and leftover bytes to write
-  u64FullBuffersToWrite = pxState->u64DevSizeBytes / pxState->u32BufSize;
-  u64LeftoverBytesToWrite = pxState->u64DevSizeBytes - (u64FullBuffersToWrite * pxState->u32BufSize);
 
-  // FIXME: Correct additional flags
-  //iFd = open(pxState->sDevice, O_WRONLY | O_SYNC);
-  pxState->iFd = open(pxState->sDevice, O_WRONLY);
 
-  if (pxState->iFd == -1)
-  {
-    printf("Error: Unable to open the device in write mode\n");
+// File may also be fd:N for a descriptor inherited from the caller
+static uint8_t bDC_StartStreamer(tDcStreamer* pxStreamer, tDcState* pxTemplate,
+				 tDcState** ppxStates)
+{
+  int iFd = -1;
 
-    pxState->u8WantBuffer = 100;
-    sem_post(&(pxState->xSemThread));
-    pthread_join(pxState->xAllocatorThread, NULL);
-    free(pxState->apMemBufs[0]);
-    free(pxState->apMemBufs[1]);
-    sem_destroy(&(pxState->xSemThread));
-    sem_destroy(&(pxState->xSemBuffer0));
-    sem_destroy(&(pxState->xSemBuffer1));
+  memset(pxStreamer, 0, sizeof(*pxStreamer));
+  pxStreamer->ppxStates = ppxStates;
+  pxStreamer->u32Count = pxTemplate->u32DeviceCount;
+  pxStreamer->u8Format = pxTemplate->u8StreamFormat;
+  pxStreamer->u32IntervalMs = pxTemplate->u32StreamIntervalMs;
 
-    return 0;
+  if (sscanf(pxTemplate->sStreamFile, "fd:%d", &iFd) == 1)
+  {
+    pxStreamer->pxFile = fdopen(iFd, "w");
+  }
+  else
+  {
+    pxStreamer->pxFile = fopen(pxTemplate->sStreamFile, "w");
   }
-  printf("Write test starting\n");
-  // Write couple of newlines in sync to the prevline sequences
-  printf("\n\n");
+  pxStreamer->pxLastTimes = calloc(pxStreamer->u32Count, sizeof(struct timeval));
+  pxStreamer->pu64LastLeftBytes = calloc(pxStreamer->u32Count, sizeof(uint64_t));
+  pxStreamer->pu8LastPhases = calloc(pxStreamer->u32Count, sizeof(uint8_t));
 
-  // Make initial zero print a bit earlier:
-  gettimeofday(&(pxState->xLastTime), NULL);
-  pxState->xLastTime.tv_sec -= (ADT_DC_PROGRESS_UPDATE_INTERVAL + 1);
-  // Actual start of routine loop
-  gettimeofday(&(pxState->xStartTime), NULL);
-  
-  // In loop prepare the buffer and write
-  for (u64WriteBufferNum = 0; u64WriteBufferNum < u64FullBuffersToWrite; u64WriteBufferNum++)
+  if ((pxStreamer->pxFile == NULL) || (pxStreamer->pxLastTimes == NULL) ||
+      (pxStreamer->pu64LastLeftBytes == NULL) || (pxStreamer->pu8LastPhases == NULL))
   {
-    if (pxState->u8WantBuffer == 0)
-    {
-      pxState->u8WantBuffer = 1;
-      // Let thread allocate at the same time we write:
-      sem_post(&(pxState->xSemThread));
-      sem_wait(&(pxState->xSemBuffer0));
-      u64WrittenCallBytes = write(pxState->iFd, pxState->apMemBufs[0], pxState->u32BufSize);
-    }
-    else // pxState->u8WantBuffer == 1
+    printf("Error: Unable to start progress stream to %s\n", pxTemplate->sStreamFile);
+
+    if (pxStreamer->pxFile != NULL)
     {
-      pxState->u8WantBuffer = 0;
-      // Let thread allocate at the same time we write:
-      sem_post(&(pxState->xSemThread));
-      sem_wait(&(pxState->xSemBuffer1));
-      u64WrittenCallBytes = write(pxState->iFd, pxState->apMemBufs[1], pxState->u32BufSize);
+      fclose(pxStreamer->pxFile);
     }
-    if (u64WrittenCallBytes != pxState->u32BufSize)
-    {
-      printf("Error: Problem writing bytes %" PRIu64 "\n",
-	     pxState->u32BufSize * u64WriteBufferNum);
+    free(pxStreamer->pxLastTimes);
+    free(pxStreamer->pu64LastLeftBytes);
+    free(pxStreamer->pu8LastPhases);
 
-      pxState->u8WantBuffer = 100;
-      sem_post(&(pxState->xSemThread));
-      pthread_join(pxState->xAllocatorThread, NULL);
-      free(pxState->apMemBufs[0]);
-      free(pxState->apMemBufs[1]);
-      sem_destroy(&(pxState->xSemThread));
-      sem_destroy(&(pxState->xSemBuffer0));
-      sem_destroy(&(pxState->xSemBuffer1));
-      close(pxState->iFd);
-
-      return 0;
-    }
-    // Update counters and print info
-    pxState->u64NowDataLeftBytes -= pxState->u32BufSize;
-    DC_PrintProgress(pxState, 0);
+    return 0;
   }
-  if (u64LeftoverBytesToWrite)
+  if (pxStreamer->u8Format == ADT_DC_STREAM_CSV)
   {
-    if (pxState->u8WantBuffer == 0)
-    {
-      sem_wait(&(pxState->xSemBuffer0));
-      u64WrittenCallBytes = write(pxState->iFd, pxState->apMemBufs[0],
-				  u64LeftoverBytesToWrite);
-    }
-    else // pxState->u8WantBuffer == 1
-    {
-      sem_wait(&(pxState->xSemBuffer1));
-      u64WrittenCallBytes = write(pxState->iFd, pxState->apMemBufs[1],
-				  u64LeftoverBytesToWrite);
-    }
-    if (u64WrittenCallBytes != u64LeftoverBytesToWrite)
-    {
-      printf("Error: Problem writing bytes %" PRIu64 "\n",
-	     pxState->u32BufSize * u64FullBuffersToWrite);
-
-      pxState->u8WantBuffer = 100;
-      sem_post(&(pxState->xSemThread));
-      pthread_join(pxState->xAllocatorThread, NULL);
-      free(pxState->apMemBufs[0]);
-      free(pxState->apMemBufs[1]);
-      sem_destroy(&(pxState->xSemThread));
-      sem_destroy(&(pxState->xSemBuffer0));
-      sem_destroy(&(pxState->xSemBuffer1));
-      close(pxState->iFd);
-
-      return 0;
-    }
-    pxState->u64NowDataLeftBytes -= u64LeftoverBytesToWrite;
+    fprintf(pxStreamer->pxFile, "t,device,phase,bytes_done,bytes_total,mibps_now,mibps_avg,"
+	    "bad_extents,write_errors,read_errors,mismatches\n");
   }
-  printf("\nSyncinc...\n\n\n");
-  fsync(pxState->iFd);
-  DC_PrintProgress(pxState, 1);
-  printf("\nDone all writing!\n");
-  close(pxState->iFd);
+  gettimeofday(&(pxStreamer->xStartTime), NULL);
+  pthread_create(&(pxStreamer->xThread), NULL, pDC_Streamer, pxStreamer);
 
-  // Bogus value so thread exits:
-  pxState->u8WantBuffer = 100;
-  sem_post(&(pxState->xSemThread));
-  pthread_join(pxState->xAllocatorThread, NULL);
-  free(pxState->apMemBufs[0]);
-  free(pxState->apMemBufs[1]);
-  sem_destroy(&(pxState->xSemThread));
-  sem_destroy(&(pxState->xSemBuffer0));
-  sem_destroy(&(pxState->xSemBuffer1));
-  
   return 1;
 }
 
 
 
-static uint8_t bDC_ReadTest(tDcState* pxState)
+static void DC_StopStreamer(tDcStreamer* pxStreamer)
 {
-  uint64_t u64ReadCallBytes = 0;
-  uint64_t u64FullBuffersToRead = 0;
-  uint64_t u64LeftoverBytesToRead = 0;
-  uint64_t u64ReadBufferNum = 0;
-  pxState->iFd = -1;
-
-  if ((sem_init(&(pxState->xSemThread), 0, 0) != 0) ||
-      (sem_init(&(pxState->xSemBuffer0), 0, 0) != 0) ||
-      (sem_init(&(pxState->xSemBuffer1), 0, 0) != 0))
-  {
-    printf("Failed to initialize semaphores\n");
+  __atomic_store_n(&(pxStreamer->u8Exit), 1, __ATOMIC_RELEASE);
+  pthread_join(pxStreamer->xThread, NULL);
+  fclose(pxStreamer->pxFile);
+  free(pxStreamer->pxLastTimes);
+  free(pxStreamer->pu64LastLeftBytes);
+  free(pxStreamer->pu8LastPhases);
+}
 
-    return 1;
-  }
 
-  pthread_create(&(pxState->xAllocatorThread), NULL,
-		 (void*)bDC_BufferAllocator, pxState);
 
-  // Need to allocate both buffers
-  pxState->apMemBufs[0] = malloc(pxState->u32BufSize);
-  pxState->apMemBufs[1] = malloc(pxState->u32BufSize);
+// Each device gets its own file when there are many, named after it
+static uint8_t bDC_DeviceFileName(char* sFile, const char* sBase, const char* sDevice)
+{
+  const char* sDevName = strrchr(sDevice, '/');
 
-  if ((pxState->apMemBufs[0] == NULL) ||
-      (pxState->apMemBufs[1] == NULL))
+  if (sBase[0] == 0)
   {
-    printf("Error: Malloc failed\n");
-    free(pxState->apMemBufs[0]);
-    free(pxState->apMemBufs[1]);
-    sem_destroy(&(pxState->xSemThread));
-    sem_destroy(&(pxState->xSemBuffer0));
-    sem_destroy(&(pxState->xSemBuffer1));
-    
-    return 0;
+    return 1;
   }
-  // Now it is time to set counters
-  pxState->u64CurrNumber = 0;
-  pxState->u64LastDataLeftBytes = pxState->u64DevSizeBytes;
-  pxState->u64NowDataLeftBytes = pxState->u64DevSizeBytes;
+  sDevName = ((sDevName == NULL) ? sDevice : (sDevName + 1));
 
-  // Thread is now waiting instructions
-  pxState->u8WantBuffer = 0;
-  // We wake another thread and sleep ourselves
-  sem_post(&(pxState->xSemThread));
-  sem_wait(&(pxState->xSemBuffer0));
-  // Ok, allocator thread has allocated buf 0.
-  // In order for the reader loop
-  // to work as expected, buffer sem needs additional post.
-  sem_post(&(pxState->xSemBuffer0));
+  return (snprintf(sFile, ADT_GEN_BUF_SIZE, "%s.%s", sBase, sDevName) < ADT_GEN_BUF_SIZE);
+}
 
-  // Figure out how many full buffers and leftover bytes to read
-  u64FullBuffersToRead = pxState->u64DevSizeBytes / pxState->u32BufSize;
-  u64LeftoverBytesToRead = pxState->u64DevSizeBytes - (u64FullBuffersToRead * pxState->u32BufSize);
 
-  // FIXME: Correct additional flags
-  //iFd = open(pxState->sDevice, O_WRONLY | O_SYNC);
-  pxState->iFd = open(pxState->sDevice, O_RDONLY);
 
-  if (pxState->iFd == -1)
-  {
-    printf("Error: Unable to open the device in read mode\n");
+// Run id of the sector headers is the seed. New runs get a fresh one
+// so that whatever is left from the earlier runs shows up as stale.
+static uint8_t bDC_NewRunId(tDcState* pxTemplate, tDcState** ppxStates)
+{
+  struct timespec xTime;
+  uint32_t i;
 
-    pxState->u8WantBuffer = 100;
-    sem_post(&(pxState->xSemThread));
-    pthread_join(pxState->xAllocatorThread, NULL);
-    free(pxState->apMemBufs[0]);
-    free(pxState->apMemBufs[1]);
-    sem_destroy(&(pxState->xSemThread));
-    sem_destroy(&(pxState->xSemBuffer0));
-    sem_destroy(&(pxState->xSemBuffer1));
+  clock_gettime(CLOCK_REALTIME, &xTime);
+  pxTemplate->u64Seed = ((((uint64_t)xTime.tv_sec) << 32) ^ ((uint64_t)xTime.tv_nsec) ^
+			 (((uint64_t)getpid()) << 48));
 
-    return 0;
+  for (i = 0; i < pxTemplate->u32DeviceCount; i++)
+  {
+    ppxStates[i]->u64Seed = pxTemplate->u64Seed;
   }
-  printf("Read test starting\n");
-  // Write couple of newlines in sync to the prevline sequences
-  printf("\n\n");
 
-  // Make initial zero print a bit earlier:
-  gettimeofday(&(pxState->xLastTime), NULL);
-  pxState->xLastTime.tv_sec -= (ADT_DC_PROGRESS_UPDATE_INTERVAL + 1);
-  // Actual start of routine loop
-  gettimeofday(&(pxState->xStartTime), NULL);
-  
-  // In loop prepare the buffer and read..
-  // ..but use buffers so that buffer0 is the compare buffer
-  // and buffer1 is the read buffer. So in other words:
-  // buffer0 = allocate
-  // buffer1 = read
-  for (u64ReadBufferNum = 0; u64ReadBufferNum < u64FullBuffersToRead; u64ReadBufferNum++)
+  return 1;
+}
+
+
+
+// Reading only and run id not given, take it from the first sector
+static uint8_t bDC_LearnRunId(tDcState* pxTemplate, tDcState** ppxStates)
+{
+  uint8_t au8Sector[ADT_PATTERN_SECTOR_SIZE];
+  tAdtSectorHeader xHeader;
+  int iFd = open(ppxStates[0]->sDevice, O_RDONLY);
+  uint32_t i;
+
+  if ((iFd == -1) ||
+      (pread(iFd, au8Sector, sizeof(au8Sector), 0) != (ssize_t)sizeof(au8Sector)) ||
+      (!bADT_PatternSectorInfo(au8Sector, &xHeader)))
   {
-    u64ReadCallBytes = read(pxState->iFd, pxState->apMemBufs[1], pxState->u32BufSize);
+    printf("Error: No intact sector header at the start of %s, give the run id with -x\n",
+	   ppxStates[0]->sDevice);
 
-    if (u64ReadCallBytes != pxState->u32BufSize)
+    if (iFd != -1)
     {
-      printf("Error: Problem reading bytes %" PRIu64 "\n",
-	     pxState->u32BufSize * u64ReadBufferNum);
-      
-      pxState->u8WantBuffer = 100;
-      sem_post(&(pxState->xSemThread));
-      pthread_join(pxState->xAllocatorThread, NULL);
-      free(pxState->apMemBufs[0]);
-      free(pxState->apMemBufs[1]);
-      sem_destroy(&(pxState->xSemThread));
-      sem_destroy(&(pxState->xSemBuffer0));
-      sem_destroy(&(pxState->xSemBuffer1));
-      close(pxState->iFd);
-      
-      return 0;
-    }
-    // Ensure after wait we have everything in compare buffer 0
-    sem_wait(&(pxState->xSemBuffer0));
-
-    // Aaand, compare it
-    if (memcmp(pxState->apMemBufs[0], pxState->apMemBufs[1], pxState->u32BufSize) != 0)
-    {
-      // TODO: Find out which byte exactly.
-      printf("\nError: Comparing failed at block beginning at %" PRIu64 "\n",
-	     pxState->u64DevSizeBytes - pxState->u64NowDataLeftBytes);
-
-      pxState->u8WantBuffer = 100;
-      sem_post(&(pxState->xSemThread));
-      pthread_join(pxState->xAllocatorThread, NULL);
-      free(pxState->apMemBufs[0]);
-      free(pxState->apMemBufs[1]);
-      sem_destroy(&(pxState->xSemThread));
-      sem_destroy(&(pxState->xSemBuffer0));
-      sem_destroy(&(pxState->xSemBuffer1));
-      close(pxState->iFd);
-      
-      return 0;
+      close(iFd);
     }
-    // Safely compared, allow another allocation
-    sem_post(&(pxState->xSemThread));
-    // Update counters and print info
-    pxState->u64NowDataLeftBytes -= pxState->u32BufSize;
-    DC_PrintProgress(pxState, 0);
+
+    return 0;
   }
-  if (u64LeftoverBytesToRead)
-  {
-    u64ReadCallBytes = read(pxState->iFd, pxState->apMemBufs[1],
-			    u64LeftoverBytesToRead);
+  close(iFd);
+  pxTemplate->u64Seed = xHeader.u64RunId;
+  pxTemplate->u32Pass = (pxTemplate->u8PassGiven ? pxTemplate->u32Pass : xHeader.u32Pass);
 
-    if (u64ReadCallBytes != u64LeftoverBytesToRead)
-    {
-      printf("Error: Problem reading bytes %" PRIu64 "\n",
-	     pxState->u32BufSize * u64FullBuffersToRead);
-      
-      pxState->u8WantBuffer = 100;
-      sem_post(&(pxState->xSemThread));
-      pthread_join(pxState->xAllocatorThread, NULL);
-      free(pxState->apMemBufs[0]);
-      free(pxState->apMemBufs[1]);
-      sem_destroy(&(pxState->xSemThread));
-      sem_destroy(&(pxState->xSemBuffer0));
-      sem_destroy(&(pxState->xSemBuffer1));
-      close(pxState->iFd);
-      
-      return 0;
-    }
-    // Final compare
-    if (memcmp(pxState->apMemBufs[0], pxState->apMemBufs[1], u64LeftoverBytesToRead) != 0)
-    {
-      // TODO: Find out which byte exactly.
-      printf("\nError: Comparing failed at block beginning at %" PRIu64 "\n",
-	     pxState->u32BufSize * u64FullBuffersToRead);
-
-      pxState->u8WantBuffer = 100;
-      sem_post(&(pxState->xSemThread));
-      pthread_join(pxState->xAllocatorThread, NULL);
-      free(pxState->apMemBufs[0]);
-      free(pxState->apMemBufs[1]);
-      sem_destroy(&(pxState->xSemThread));
-      sem_destroy(&(pxState->xSemBuffer0));
-      sem_destroy(&(pxState->xSemBuffer1));
-      close(pxState->iFd);
-      
-      return 0;
-    }
-    pxState->u64NowDataLeftBytes -= u64LeftoverBytesToRead;
+  for (i = 0; i < pxTemplate->u32DeviceCount; i++)
+  {
+    ppxStates[i]->u64Seed = pxTemplate->u64Seed;
+    ppxStates[i]->u32Pass = pxTemplate->u32Pass;
   }
-  // No sync needed
-  DC_PrintProgress(pxState, 1);
-  printf("\nDone all reading, compare OK!\n");
-  close(pxState->iFd);
+  printf("Run id and pass taken from the first sector of %s\n", ppxStates[0]->sDevice);
 
-  // Bogus value so thread exits:
-  pxState->u8WantBuffer = 100;
-  sem_post(&(pxState->xSemThread));
-  pthread_join(pxState->xAllocatorThread, NULL);
-  free(pxState->apMemBufs[0]);
-  free(pxState->apMemBufs[1]);
-  sem_destroy(&(pxState->xSemThread));
-  sem_destroy(&(pxState->xSemBuffer0));
-  sem_destroy(&(pxState->xSemBuffer1));
-  
   return 1;
 }
 
@@ -617,7 +4352,14 @@ static uint8_t bDC_ReadTest(tDcState* pxState)
 int main(int argc, char* argv[])
 {
   int iTemp = 0;
+  uint32_t i;
   tDcState* pxState;
+  tDcState** ppxStates = NULL;
+  uint8_t u8AnyWrite = 0;
+  uint8_t u8Sparse = 0;
+  tDcStreamer xStreamer;
+  uint32_t u32Zone = 0;
+  uint32_t u32FitRequests = 0;
   char sReadBuf[ADT_GEN_BUF_SIZE] = { 0 };
   char sSizeHumReadBuf[ADT_GEN_BUF_SIZE] = { 0 };
   char sModel[ADT_DISK_INFO_MODEL_LEN + 1] = { 0 };
@@ -639,69 +4381,302 @@ int main(int argc, char* argv[])
   if (!bDC_GetParams(argc, argv, pxState))
   {
     printf("Error: Params failure, use:\n");
-    printf("diskcont [-w] [-r] [-s] /path/to/device\n");
+    printf("diskcont [-w] [-r] [-s] [-d] [-u] [-n] [-q depth] [-i iosize] [-b bufsize] [-k bufcount] [-T] [-a samples|percent%%] [-W zeroout|discard|secure|write] [-f filesize] [-t threads] [-p stripes] [-V lag] [-o] [-R] [-x seed] [-C] [-N pass] [-c] [-l badblocks] [-L blocksize] [-S statefile] [--resume] [-P progressfile] [-F json|csv] [-I ms] [-M zonemap] [-z zones] [-m percent] /path/to/device [/path/to/device ...]\n");
+    free(pxState->psDevices);
     free(pxState);
 
     return 1;
   }
-  pxState->iFd = open(pxState->sDevice, O_RDONLY);
+  ppxStates = calloc(pxState->u32DeviceCount, sizeof(tDcState*));
 
-  if (pxState->iFd == -1)
+  for (i = 0; (ppxStates != NULL) && (i < pxState->u32DeviceCount); i++)
   {
-    printf("Error: Unable to open device %s (are you not root?)\n", pxState->sDevice);
-    free(pxState);
-    
-    return 1;
-  }
-  bADT_IdentifyDisk(pxState->iFd, sModel, sSerial, NULL, &(pxState->u64DevSizeBytes));
-  close(pxState->iFd);
-  pxState->iFd = -1;
+    ppxStates[i] = malloc(sizeof(tDcState));
+
+    if (ppxStates[i] == NULL)
+    {
+      printf("Failed to malloc state struct\n");
+      iTemp = -1;
+
+      break;
+    }
+    // Every device gets its own copy of the settings
+    memcpy(ppxStates[i], pxState, sizeof(tDcState));
+    strcpy(ppxStates[i]->sDevice, pxState->psDevices[i]);
+    ppxStates[i]->u8Multi = (pxState->u32DeviceCount > 1);
+    pthread_mutex_init(&(ppxStates[i]->xExtentMutex), NULL);
+    pthread_mutex_init(&(ppxStates[i]->xLatencyMutex), NULL);
 
-  if (iTemp == -1)
+    if (ppxStates[i]->u8Multi &&
+	((!bDC_DeviceFileName(ppxStates[i]->sBadBlocksFile, pxState->sBadBlocksFile,
+			      ppxStates[i]->sDevice)) ||
+	 (!bDC_DeviceFileName(ppxStates[i]->sStateFile, pxState->sStateFile,
+			      ppxStates[i]->sDevice)) ||
+	 (!bDC_DeviceFileName(ppxStates[i]->sZoneFile, pxState->sZoneFile,
+			      ppxStates[i]->sDevice))))
+    {
+      printf("Error: File name too long for %s\n", ppxStates[i]->sDevice);
+      iTemp = -1;
+    }
+  }
+  if (ppxStates == NULL)
   {
-    printf("Error: Unable to get info for device (%s)!\n", pxState->sDevice);
-    free(pxState);
-    
-    return 1;
+    printf("Failed to malloc state struct\n");
+    iTemp = -1;
   }
-  ADT_BytesToHumanReadable(pxState->u64DevSizeBytes, sSizeHumReadBuf);
-  printf("Found device %s   %s\n", pxState->sDevice, sSizeHumReadBuf);
-  printf("Model: %s   Serial: %s\n", sModel, sSerial);
-  
-  if (pxState->u8Write)
+  for (i = 0; (iTemp != -1) && (i < pxState->u32DeviceCount); i++)
   {
-    // Write test
-    if (!pxState->u8Silent)
+    if (pxState->u64FileSizeBytes &&
+	(!bADT_PrepareFile(ppxStates[i]->sDevice, pxState->u64FileSizeBytes, &u8Sparse)))
+    {
+      printf("Error: Unable to prepare file %s: %s\n", ppxStates[i]->sDevice, strerror(errno));
+      iTemp = -1;
+
+      break;
+    }
+    if (pxState->u64FileSizeBytes && u8Sparse)
     {
-      printf("This write test will COMPLETELY WIPE OUT %s\n", pxState->sDevice);
-      printf("To continue, type uppercase yes\n");
-      fgets(sReadBuf, sizeof(sReadBuf), stdin);
+      printf("No fallocate for %s, using a sparse file\n", ppxStates[i]->sDevice);
+    }
+    ppxStates[i]->iFd = open(ppxStates[i]->sDevice, O_RDONLY);
+
+    if (ppxStates[i]->iFd == -1)
+    {
+      printf("Error: Unable to open device %s (are you not root?)\n", ppxStates[i]->sDevice);
+      iTemp = -1;
+
+      break;
+    }
+    bADT_IdentifyDisk(ppxStates[i]->iFd, sModel, sSerial, NULL, &(ppxStates[i]->u64DevSizeBytes));
+    bADT_GetBlockSize(ppxStates[i]->iFd, &(ppxStates[i]->u32BlockSize));
+    ppxStates[i]->iNumaNode = iADT_DeviceNumaNode(ppxStates[i]->iFd);
+
+    // Shared buffers go near the disks only if they all sit together
+    pxState->iNumaNode = (((i == 0) || (pxState->iNumaNode == ppxStates[i]->iNumaNode)) ?
+			  ppxStates[i]->iNumaNode : -1);
+    ppxStates[i]->u64RegionEnd = ppxStates[i]->u64DevSizeBytes;
+    ppxStates[i]->u64TotalBytes = ppxStates[i]->u64DevSizeBytes;
+    close(ppxStates[i]->iFd);
+    ppxStates[i]->iFd = -1;
+
+    if (ppxStates[i]->u64DevSizeBytes == 0)
+    {
+      printf("Error: Unable to get info for device (%s)!\n", ppxStates[i]->sDevice);
+      iTemp = -1;
 
-      if (strncmp(sReadBuf, "YES", strlen("YES")) != 0)
+      break;
+    }
+    ADT_BytesToHumanReadable(ppxStates[i]->u64DevSizeBytes, sSizeHumReadBuf);
+    printf("Found device %s   %s\n", ppxStates[i]->sDevice, sSizeHumReadBuf);
+    printf("Model: %s   Serial: %s\n", sModel, sSerial);
+    strcpy(ppxStates[i]->sSerial, sSerial);
+
+    if (ppxStates[i]->sZoneFile[0] != 0)
+    {
+      // Tiny devices get fewer zones than asked
+      ppxStates[i]->u64ZoneBytes = ((ppxStates[i]->u64DevSizeBytes + ppxStates[i]->u32Zones - 1) /
+				    ppxStates[i]->u32Zones);
+      ppxStates[i]->u32Zones = (uint32_t)((ppxStates[i]->u64DevSizeBytes + ppxStates[i]->u64ZoneBytes - 1) /
+					  ppxStates[i]->u64ZoneBytes);
+      ppxStates[i]->pxZones = calloc(2 * ppxStates[i]->u32Zones, sizeof(tDcZone));
+
+      if (ppxStates[i]->pxZones == NULL)
       {
-	printf("Error: User failed to confirm operation\n");
-	free(pxState);
-	
-	return 1;
+	printf("Failed to malloc zone map\n");
+	iTemp = -1;
+
+	break;
+      }
+      for (u32Zone = 0; u32Zone < (2 * ppxStates[i]->u32Zones); u32Zone++)
+      {
+	ppxStates[i]->pxZones[u32Zone].u64FirstStartNanos = UINT64_MAX;
       }
     }
-    if (!bDC_WriteTest(pxState))
+
+    if (ppxStates[i]->u8Resume && (!bDC_LoadCheckpoint(ppxStates[i])))
+    {
+      iTemp = -1;
+
+      break;
+    }
+    if (ppxStates[i]->u8Resume)
     {
-      free(pxState);
+      // Pattern is the same for all, so must be their checkpoints
+      if ((i > 0) && ((ppxStates[i]->u8OffsetKeyed != pxState->u8OffsetKeyed) ||
+		      (ppxStates[i]->u8Random != pxState->u8Random) ||
+		      (ppxStates[i]->u8Sectors != pxState->u8Sectors) ||
+		      (ppxStates[i]->u32Pass != pxState->u32Pass) ||
+		      (ppxStates[i]->u64Seed != pxState->u64Seed)))
+      {
+	printf("Error: Checkpoints of the devices have different patterns\n");
+	iTemp = -1;
+
+	break;
+      }
+      pxState->u8OffsetKeyed = ppxStates[i]->u8OffsetKeyed;
+      pxState->u8Random = ppxStates[i]->u8Random;
+      pxState->u8Sectors = ppxStates[i]->u8Sectors;
+      pxState->u32Pass = ppxStates[i]->u32Pass;
+      pxState->u8SeedGiven = 1;
+      pxState->u64Seed = ppxStates[i]->u64Seed;
+
+      // Read is left to do in any case, write only if interrupted
+      ppxStates[i]->u8Write = (ppxStates[i]->u8ResumePhase == ADT_DC_PHASE_WRITE);
+      ppxStates[i]->u8Read = ((ppxStates[i]->u8ResumePhase == ADT_DC_PHASE_READ) ||
+			      ppxStates[i]->u8Read);
+      printf("Resuming %s test from checkpoint %s\n",
+	     (ppxStates[i]->u8Write ? "write" : "read"), ppxStates[i]->sStateFile);
+    }
+    u8AnyWrite |= ppxStates[i]->u8Write;
 
-      return 1;
+    if (ppxStates[i]->u8Direct)
+    {
+      // Direct I/O transfers must be whole logical blocks
+      ppxStates[i]->u32BufSize -= (ppxStates[i]->u32BufSize % ppxStates[i]->u32BlockSize);
+      ppxStates[i]->u32IoSize -= (ppxStates[i]->u32IoSize % ppxStates[i]->u32BlockSize);
+      ppxStates[i]->u32IoSize = ((ppxStates[i]->u32IoSize < ppxStates[i]->u32BlockSize) ?
+				 ppxStates[i]->u32BlockSize : ppxStates[i]->u32IoSize);
+      printf("Using direct I/O, logical block size %u bytes\n", ppxStates[i]->u32BlockSize);
+    }
+    // Shared buffers must suit the pickiest device
+    if (ppxStates[i]->u32BlockSize > pxState->u32BlockSize)
+    {
+      pxState->u32BlockSize = ppxStates[i]->u32BlockSize;
     }
   }
-  if (pxState->u8Read)
+  if (iTemp != -1)
   {
-    if (!bDC_ReadTest(pxState))
+    ADT_PatternInit(pxState->u8NonTemporal);
+
+    if (pxState->u8Sectors && (!pxState->u8SeedGiven) &&
+	(!(u8AnyWrite ? bDC_NewRunId(pxState, ppxStates) : bDC_LearnRunId(pxState, ppxStates))))
+    {
+      iTemp = -1;
+    }
+  }
+  if (iTemp != -1)
+  {
+    ADT_PatternSetKey(pxState->u8OffsetKeyed, pxState->u8Random, pxState->u64Seed);
+    ADT_PatternSetSectors(pxState->u8Sectors, pxState->u64Seed, pxState->u32Pass);
+    printf("Pattern kernel: %s%s, %u threads\n", sADT_PatternKernelName(),
+	   (pxState->u8NonTemporal ? " non-temporal" : ""), pxState->u32GenThreads);
+
+    if (pxState->u8OffsetKeyed || pxState->u8Random || pxState->u64Seed)
+    {
+      // Needed again for reading back
+      printf("Pattern: %s%s, seed 0x%016" PRIx64 "\n",
+	     (pxState->u8Random ? "random over " : ""),
+	     (pxState->u8OffsetKeyed ? "byte offsets" : "running numbers"), pxState->u64Seed);
+    }
+    if (pxState->u8Sectors)
+    {
+      printf("Sector headers: run id 0x%016" PRIx64 ", pass %u\n",
+	     pxState->u64Seed, pxState->u32Pass);
+    }
+  }
+  if ((iTemp != -1) && u8AnyWrite && (!pxState->u8Silent))
+  {
+    // Write test
+    for (i = 0; i < pxState->u32DeviceCount; i++)
+    {
+      if (ppxStates[i]->u8Write)
+      {
+	printf("This %s will COMPLETELY WIPE OUT %s\n",
+	       (pxState->u8Wipe ? "wipe" : "write test"), ppxStates[i]->sDevice);
+      }
+    }
+    printf("To continue, type uppercase yes\n");
+    fgets(sReadBuf, sizeof(sReadBuf), stdin);
+
+    if (strncmp(sReadBuf, "YES", strlen("YES")) != 0)
+    {
+      printf("Error: User failed to confirm operation\n");
+      iTemp = -1;
+    }
+  }
+  for (i = 0; (iTemp != -1) && pxState->u8Tune && (i < pxState->u32DeviceCount); i++)
+  {
+    if (!bDC_TuneDevice(ppxStates[i]))
+    {
+      iTemp = -1;
+    }
+    // Shared buffers must fit the biggest choice
+    if ((i == 0) || (ppxStates[i]->u32BufSize > pxState->u32BufSize))
     {
-      free(pxState);
+      pxState->u32BufSize = ppxStates[i]->u32BufSize;
+    }
+  }
+  for (i = 0; (iTemp != -1) && (i < pxState->u32DeviceCount); i++)
+  {
+    // Requests never span buffers, so one buffer caps the depth
+    u32FitRequests = ppxStates[i]->u32BufSize / ppxStates[i]->u32IoSize;
+    u32FitRequests = ((u32FitRequests == 0) ? 1 : u32FitRequests);
 
-      return 1;
+    if (ppxStates[i]->u8Uring && (!ppxStates[i]->u8Sample) &&
+	(u32FitRequests < ppxStates[i]->u32QueueDepth))
+    {
+      ADT_BytesToHumanReadable(ppxStates[i]->u32BufSize, sSizeHumReadBuf);
+      printf("Warning: Only %u requests fit in a %s buffer, queue depth lowered from %u for %s\n",
+	     u32FitRequests, sSizeHumReadBuf, ppxStates[i]->u32QueueDepth, ppxStates[i]->sDevice);
+      ppxStates[i]->u32QueueDepth = u32FitRequests;
+    }
+  }
+  if ((iTemp != -1) && (pxState->sStreamFile[0] != 0) &&
+      (!bDC_StartStreamer(&xStreamer, pxState, ppxStates)))
+  {
+    iTemp = -1;
+  }
+  if ((iTemp != -1) && (pxState->u32DeviceCount == 1))
+  {
+    pDC_DeviceThread(ppxStates[0]);
+  }
+  else if (iTemp != -1)
+  {
+    DC_RunMultiTest(pxState, ppxStates);
+  }
+  if ((iTemp != -1) && (pxState->sStreamFile[0] != 0))
+  {
+    DC_StopStreamer(&xStreamer);
+  }
+  for (i = 0; (ppxStates != NULL) && (i < pxState->u32DeviceCount); i++)
+  {
+    if (ppxStates[i] == NULL)
+    {
+      continue;
+    }
+    if ((iTemp != -1) && ppxStates[i]->u8Multi)
+    {
+      printf("\n%s: %s\n", ppxStates[i]->sDevice,
+	     ((ppxStates[i]->u8Phase != ADT_DC_PHASE_DONE) ? "test FAILED" :
+	      ((ppxStates[i]->u32ExtentCount > 0) ? "bad extents found" : "all OK")));
+    }
+    if (iTemp != -1)
+    {
+      DC_ReportLatency(ppxStates[i]);
+    }
+    if ((iTemp != -1) && (ppxStates[i]->pxZones != NULL))
+    {
+      DC_WriteZoneMap(ppxStates[i]);
+    }
+    if ((iTemp != -1) && (ppxStates[i]->u32ExtentCount > 0))
+    {
+      DC_ReportBadExtents(ppxStates[i]);
+    }
+    if ((ppxStates[i]->u8Phase != ADT_DC_PHASE_DONE) ||
+	(ppxStates[i]->u32ExtentCount > 0))
+    {
+      iTemp = -1;
     }
+    pthread_mutex_destroy(&(ppxStates[i]->xExtentMutex));
+    pthread_mutex_destroy(&(ppxStates[i]->xLatencyMutex));
+    free(ppxStates[i]->pu64ResumeOffsets);
+    free(ppxStates[i]->pxExtents);
+    free(ppxStates[i]->pxZones);
+    free(ppxStates[i]);
   }
+  free(ppxStates);
+  free(pxState->psDevices);
   free(pxState);
 
-  return 0;
+  return ((iTemp == -1) ? 1 : 0);
 }
@@ -0,0 +1,492 @@
+#define _GNU_SOURCE // For syscall
+
+#include "adt_shared.h"
+#include "adt_pattern.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ADT_KB_HAS_TSC
+#endif
+
+#define ADT_KB_VERSION_STR "Kernbench v. 1.00 by Janne Paalijarvi\n"
+#define ADT_KB_MIN_SIZE (((uint64_t)16) * ADT_BYTES_IN_KIBIBYTE)
+#define ADT_KB_DEFAULT_MAX_SIZE ((uint64_t)ADT_BYTES_IN_GIBIBYTE)
+#define ADT_KB_SIZE_STEP ((uint64_t)16)
+#define ADT_KB_DEFAULT_TIME_MS ((uint32_t)200)
+#define ADT_KB_SEED ((uint64_t)0x5eed)
+#define ADT_KB_CHECK_START ((uint64_t)0x0123456789abcdef)
+#define ADT_KB_CHECK_MISALIGN ((uint64_t)8)
+// Room for the largest check at the misaligned start, plus a word
+// after it so that writing past the end shows
+#define ADT_KB_CHECK_BYTES (ADT_KB_MIN_SIZE + ADT_KB_CHECK_MISALIGN)
+
+// What is timed on the buffer
+#define ADT_KB_OP_FILL ((uint8_t)(0))
+#define ADT_KB_OP_VERIFY ((uint8_t)(1))
+#define ADT_KB_OP_CRC ((uint8_t)(2))
+#define ADT_KB_OP_MEMCMP ((uint8_t)(3))
+
+
+
+typedef struct
+{
+  uint64_t u64MaxSize;
+  uint32_t u32TimeMs;
+  uint8_t u8CheckOnly;
+  char sKernel[ADT_GEN_BUF_SIZE];
+  tAdtMem xMem;
+  tAdtMem xCompMem;
+  int iCycleFd;
+  volatile uint64_t u64Sink;
+
+} tKbState;
+
+
+typedef struct
+{
+  const char* sName;
+  uint8_t u8Op;
+  uint8_t u8NonTemporal;
+  uint8_t u8Random;
+  uint8_t u8Sectors;
+
+} tKbCase;
+
+
+// Same as diskcont does with -n, -R and -C
+static const tKbCase axKbPatternCases[] =
+{
+  { "fill", ADT_KB_OP_FILL, 0, 0, 0 },
+  { "fill-nt", ADT_KB_OP_FILL, 1, 0, 0 },
+  { "verify", ADT_KB_OP_VERIFY, 0, 0, 0 },
+  { "random-fill", ADT_KB_OP_FILL, 0, 1, 0 },
+  { "random-fill-nt", ADT_KB_OP_FILL, 1, 1, 0 },
+  { "random-verify", ADT_KB_OP_VERIFY, 0, 1, 0 },
+  { "sector-fill", ADT_KB_OP_FILL, 0, 0, 1 },
+  { "sector-verify", ADT_KB_OP_VERIFY, 0, 0, 1 },
+};
+
+// Do not depend on the kernel, raidkill compares with memcmp
+static const tKbCase axKbOtherCases[] =
+{
+  { "crc32c", ADT_KB_OP_CRC, 0, 0, 0 },
+  { "memcmp", ADT_KB_OP_MEMCMP, 0, 0, 0 },
+};
+
+// Word counts for the self check, odd ones hit the scalar head and
+// tail of the vector kernels. Largest fits in the 16K minimum.
+static const uint64_t au64KbCheckWords[] = { 1, 3, 7, 64, 1000, 2047 };
+
+
+
+static uint8_t bKB_GetParams(int argc, char* argv[], tKbState* pxState)
+{
+  uint32_t i;
+  uint64_t u64Temp = 0;
+
+  // Default settings
+  pxState->u64MaxSize = ADT_KB_DEFAULT_MAX_SIZE;
+  pxState->u32TimeMs = ADT_KB_DEFAULT_TIME_MS;
+
+  memset(pxState->sKernel, 0, ADT_GEN_BUF_SIZE);
+
+  for (i = 1; i < (uint32_t)argc; i++)
+  {
+    if (strcmp("-c", argv[i]) == 0)
+    {
+      pxState->u8CheckOnly = 1;
+    }
+    else if ((strcmp("-m", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseSize(argv[i], &u64Temp)) || (u64Temp < ADT_KB_MIN_SIZE))
+      {
+	return 0;
+      }
+      pxState->u64MaxSize = u64Temp;
+    }
+    else if ((strcmp("-k", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if (strlen(argv[i]) >= ADT_GEN_BUF_SIZE)
+      {
+	return 0;
+      }
+      strcpy(pxState->sKernel, argv[i]);
+    }
+    else if ((strcmp("-i", argv[i]) == 0) && ((i + 1) < (uint32_t)argc))
+    {
+      i++;
+
+      if ((!bADT_ParseCount(argv[i], &u64Temp)) || (u64Temp == 0) || (u64Temp > UINT32_MAX))
+      {
+	return 0;
+      }
+      pxState->u32TimeMs = (uint32_t)u64Temp;
+    }
+    else
+    {
+      // Wrong parameter
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+
+
+static uint64_t u64KB_NowNanos(void)
+{
+  struct timespec xNow;
+
+  clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+  return ((((uint64_t)xNow.tv_sec) * 1000000000) + xNow.tv_nsec);
+}
+
+
+
+// Core cycles from the PMU when allowed, so turbo and throttling
+// don't skew them. Virtual machines often have no PMU.
+static void KB_OpenCycleCounter(tKbState* pxState)
+{
+  struct perf_event_attr xAttr;
+
+  memset(&xAttr, 0, sizeof(xAttr));
+  xAttr.size = sizeof(xAttr);
+  xAttr.type = PERF_TYPE_HARDWARE;
+  xAttr.config = PERF_COUNT_HW_CPU_CYCLES;
+  xAttr.exclude_kernel = 1;
+  xAttr.exclude_hv = 1;
+
+  pxState->iCycleFd = syscall(__NR_perf_event_open, &xAttr, 0, -1, -1, 0);
+}
+
+
+
+// Zero if no way to count
+static uint64_t u64KB_Cycles(tKbState* pxState)
+{
+  uint64_t u64Cycles = 0;
+
+  if (pxState->iCycleFd != -1)
+  {
+    if (read(pxState->iCycleFd, &u64Cycles, sizeof(u64Cycles)) != sizeof(u64Cycles))
+    {
+      return 0;
+    }
+
+    return u64Cycles;
+  }
+#ifdef ADT_KB_HAS_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+
+
+static void KB_RunOnce(tKbState* pxState, const tKbCase* pxCase, uint64_t u64Bytes)
+{
+  uint64_t u64Expected = 0;
+  uint64_t u64Actual = 0;
+  uint8_t u8Kind = 0;
+
+  if (pxCase->u8Op == ADT_KB_OP_FILL)
+  {
+    ADT_PatternFill(pxState->xMem.pMem, u64Bytes, 0);
+  }
+  else if (pxCase->u8Op == ADT_KB_OP_VERIFY)
+  {
+    pxState->u64Sink += u64ADT_PatternVerify(pxState->xMem.pMem, u64Bytes, 0,
+					     &u64Expected, &u64Actual, &u8Kind);
+  }
+  else if (pxCase->u8Op == ADT_KB_OP_CRC)
+  {
+    pxState->u64Sink += u32ADT_PatternCrc32c(pxState->xMem.pMem, u64Bytes);
+  }
+  else
+  {
+    pxState->u64Sink += memcmp(pxState->xCompMem.pMem, pxState->xMem.pMem, u64Bytes);
+  }
+}
+
+
+
+// Repeats until the time is up, one untimed round first to warm
+// the caches up for the sizes that fit
+static void KB_Measure(tKbState* pxState, const char* sKernel, const tKbCase* pxCase,
+		       uint64_t u64Bytes)
+{
+  uint64_t u64Rounds = 0;
+  uint64_t u64StartNanos = 0;
+  uint64_t u64StartCycles = 0;
+  uint64_t u64Nanos = 0;
+  uint64_t u64Cycles = 0;
+  char sSizeHumReadBuf[ADT_GEN_BUF_SIZE] = { 0 };
+  char sCyclesBuf[ADT_GEN_BUF_SIZE] = { 0 };
+
+  KB_RunOnce(pxState, pxCase, u64Bytes);
+  u64StartCycles = u64KB_Cycles(pxState);
+  u64StartNanos = u64KB_NowNanos();
+
+  do
+  {
+    KB_RunOnce(pxState, pxCase, u64Bytes);
+    u64Rounds++;
+    u64Nanos = u64KB_NowNanos() - u64StartNanos;
+  }
+  while (u64Nanos < (pxState->u32TimeMs * ((uint64_t)1000000)));
+
+  u64Cycles = u64KB_Cycles(pxState) - u64StartCycles;
+  ADT_BytesToHumanReadable(u64Bytes, sSizeHumReadBuf);
+  snprintf(sCyclesBuf, ADT_GEN_BUF_SIZE, "-");
+
+  if (u64Cycles)
+  {
+    snprintf(sCyclesBuf, ADT_GEN_BUF_SIZE, "%.3f", (1.0 * u64Cycles) / (1.0 * u64Rounds * u64Bytes));
+  }
+  printf("%-8s %-16s %10s %10.2f %10s\n", sKernel, pxCase->sName, sSizeHumReadBuf,
+	 (1.0 * u64Rounds * u64Bytes) / (1.0 * u64Nanos), sCyclesBuf);
+  fflush(stdout);
+}
+
+
+
+// Sizes go from L1 resident up to the max in steps of 16
+static void KB_RunCase(tKbState* pxState, const char* sKernel, const tKbCase* pxCase)
+{
+  uint64_t u64Bytes = ADT_KB_MIN_SIZE;
+  uint64_t u64Expected = 0;
+  uint64_t u64Actual = 0;
+  uint8_t u8Kind = 0;
+
+  ADT_PatternSetKey(0, pxCase->u8Random, ADT_KB_SEED);
+  ADT_PatternSetSectors(pxCase->u8Sectors, ADT_KB_SEED, 0);
+
+  if (pxCase->u8Op != ADT_KB_OP_FILL)
+  {
+    // Compares must go through all of it to be fair
+    ADT_PatternFill(pxState->xMem.pMem, pxState->u64MaxSize, 0);
+    memcpy(pxState->xCompMem.pMem, pxState->xMem.pMem, pxState->u64MaxSize);
+
+    if ((pxCase->u8Op == ADT_KB_OP_VERIFY) &&
+	(u64ADT_PatternVerify(pxState->xMem.pMem, pxState->u64MaxSize, 0,
+			      &u64Expected, &u64Actual, &u8Kind) != pxState->u64MaxSize))
+    {
+      printf("%-8s %-16s verify fails on its own fill!\n", sKernel, pxCase->sName);
+
+      return;
+    }
+  }
+  while (1)
+  {
+    KB_Measure(pxState, sKernel, pxCase, u64Bytes);
+
+    if (u64Bytes >= pxState->u64MaxSize)
+    {
+      break;
+    }
+    u64Bytes = (((u64Bytes * ADT_KB_SIZE_STEP) > pxState->u64MaxSize) ?
+		pxState->u64MaxSize : (u64Bytes * ADT_KB_SIZE_STEP));
+  }
+}
+
+
+
+// Scalar is the reference: every fill of every other kernel must
+// give the same bytes, and every verify must agree where it differs.
+static uint8_t bKB_CheckKernel(tKbState* pxState, const tAdtPatternKernel* pxKernel)
+{
+  const tAdtPatternKernel* pxScalar = pxADT_PatternKernel(0);
+  const char* asFillNames[] = { "fill", "fill-nt", "random-fill", "random-fill-nt" };
+  tAdtFillFunc apfFills[] = { pxKernel->pfFill, pxKernel->pfFillNonTemporal,
+			      pxKernel->pfFillRandom, pxKernel->pfFillRandomNonTemporal };
+  tAdtFillFunc apfScalarFills[] = { pxScalar->pfFill, pxScalar->pfFillNonTemporal,
+				    pxScalar->pfFillRandom, pxScalar->pfFillRandomNonTemporal };
+  tAdtVerifyFunc apfVerifies[] = { pxKernel->pfVerify, pxKernel->pfVerifyRandom };
+  uint64_t* pu64Words = NULL;
+  uint64_t u64Words = 0;
+  uint64_t u64Step = 0;
+  uint64_t u64Misalign = 0;
+  uint64_t u64Index = 0;
+  uint32_t i;
+  uint32_t j;
+
+  for (i = 0; i < (sizeof(apfFills) / sizeof(apfFills[0])); i++)
+  {
+    for (j = 0; j < (sizeof(au64KbCheckWords) / sizeof(au64KbCheckWords[0])); j++)
+    {
+      for (u64Step = 1; u64Step <= ADT_PATTERN_WORD_SIZE; u64Step += (ADT_PATTERN_WORD_SIZE - 1))
+      {
+	for (u64Misalign = 0; u64Misalign <= ADT_KB_CHECK_MISALIGN;
+	     u64Misalign += ADT_KB_CHECK_MISALIGN)
+	{
+	  u64Words = au64KbCheckWords[j];
+	  pu64Words = (uint64_t*)(pxState->xMem.pMem + u64Misalign);
+	  memset(pxState->xMem.pMem, 0, ADT_KB_CHECK_BYTES);
+	  memset(pxState->xCompMem.pMem, 0, ADT_KB_CHECK_BYTES);
+	  apfFills[i](pu64Words, u64Words, ADT_KB_CHECK_START, u64Step, ADT_KB_SEED);
+	  apfScalarFills[i](pxState->xCompMem.pMem + u64Misalign, u64Words,
+			    ADT_KB_CHECK_START, u64Step, ADT_KB_SEED);
+
+	  // Whole buffer, so that writing past the end shows too
+	  if (memcmp(pxState->xMem.pMem, pxState->xCompMem.pMem, ADT_KB_CHECK_BYTES) != 0)
+	  {
+	    printf("Error: %s %s differs from scalar, %" PRIu64 " words, step %" PRIu64
+		   ", offset %" PRIu64 "\n", pxKernel->sName, asFillNames[i],
+		   u64Words, u64Step, u64Misalign);
+
+	    return 0;
+	  }
+	  // Good as is, then one bit flipped in the middle
+	  u64Index = apfVerifies[i / 2](pu64Words, u64Words, ADT_KB_CHECK_START,
+					u64Step, ADT_KB_SEED);
+	  pu64Words[u64Words / 2] ^= 1;
+
+	  if ((u64Index != u64Words) ||
+	      (apfVerifies[i / 2](pu64Words, u64Words, ADT_KB_CHECK_START, u64Step,
+				  ADT_KB_SEED) != (u64Words / 2)))
+	  {
+	    printf("Error: %s verify disagrees with %s, %" PRIu64 " words, step %" PRIu64
+		   ", offset %" PRIu64 "\n", pxKernel->sName, asFillNames[i],
+		   u64Words, u64Step, u64Misalign);
+
+	    return 0;
+	  }
+	}
+      }
+    }
+  }
+
+  return 1;
+}
+
+
+
+static uint8_t bKB_SelfCheck(tKbState* pxState)
+{
+  const tAdtPatternKernel* pxKernel = NULL;
+  uint32_t u32Checked = 0;
+  uint32_t i;
+
+  for (i = 0; i < u32ADT_PatternKernelCount(); i++)
+  {
+    pxKernel = pxADT_PatternKernel(i);
+
+    if (!pxKernel->bSupported())
+    {
+      continue;
+    }
+    if (!bKB_CheckKernel(pxState, pxKernel))
+    {
+      return 0;
+    }
+    u32Checked++;
+  }
+  printf("Self check OK, %u kernels match scalar\n", u32Checked);
+
+  return 1;
+}
+
+
+
+int main(int argc, char* argv[])
+{
+  uint32_t i;
+  uint32_t j;
+  const tAdtPatternKernel* pxKernel = NULL;
+  tKbState xState;
+  uint64_t u64AllocBytes = 0;
+  char sMemDescBuf[ADT_GEN_BUF_SIZE] = { 0 };
+
+  printf(ADT_KB_VERSION_STR);
+  memset(&xState, 0, sizeof(xState));
+
+  if (!bKB_GetParams(argc, argv, &xState))
+  {
+    printf("Error: Params failure, use:\n");
+    printf("kernbench [-c] [-k kernel] [-m maxsize] [-i ms]\n");
+
+    return 1;
+  }
+  // Check alone needs only the smallest size
+  u64AllocBytes = (xState.u8CheckOnly ? ADT_KB_CHECK_BYTES : xState.u64MaxSize);
+  u64AllocBytes = ((u64AllocBytes < ADT_KB_CHECK_BYTES) ? ADT_KB_CHECK_BYTES : u64AllocBytes);
+
+  if ((!bADT_MemAlloc(&(xState.xMem), u64AllocBytes, -1)) ||
+      (!bADT_MemAlloc(&(xState.xCompMem), u64AllocBytes, -1)))
+  {
+    printf("Error: Unable to allocate 2 x %" PRIu64 " bytes\n", u64AllocBytes);
+    ADT_MemFree(&(xState.xMem));
+
+    return 1;
+  }
+  ADT_MemDescribe(xState.xMem.u8Flags, sMemDescBuf);
+  printf("Buffers %s\n", sMemDescBuf);
+  ADT_PatternInit(0);
+
+  if (!bKB_SelfCheck(&xState))
+  {
+    ADT_MemFree(&(xState.xCompMem));
+    ADT_MemFree(&(xState.xMem));
+
+    return 1;
+  }
+  if (xState.u8CheckOnly)
+  {
+    ADT_MemFree(&(xState.xCompMem));
+    ADT_MemFree(&(xState.xMem));
+
+    return 0;
+  }
+  KB_OpenCycleCounter(&xState);
+  printf("Cycles from %s\n", ((xState.iCycleFd != -1) ? "the PMU" :
+#ifdef ADT_KB_HAS_TSC
+			      "the TSC, no PMU access"
+#else
+			      "nowhere, no PMU access"
+#endif
+			      ));
+  printf("%-8s %-16s %10s %10s %10s\n", "Kernel", "Test", "Size", "GB/s", "Cycles/B");
+
+  for (i = 0; i < u32ADT_PatternKernelCount(); i++)
+  {
+    pxKernel = pxADT_PatternKernel(i);
+
+    if (((xState.sKernel[0] != 0) && (strcmp(xState.sKernel, pxKernel->sName) != 0)) ||
+	(!pxKernel->bSupported()))
+    {
+      continue;
+    }
+    for (j = 0; j < (sizeof(axKbPatternCases) / sizeof(axKbPatternCases[0])); j++)
+    {
+      bADT_PatternSelectKernel(pxKernel->sName, axKbPatternCases[j].u8NonTemporal);
+      KB_RunCase(&xState, pxKernel->sName, &(axKbPatternCases[j]));
+    }
+  }
+  for (j = 0; j < (sizeof(axKbOtherCases) / sizeof(axKbOtherCases[0])); j++)
+  {
+    KB_RunCase(&xState, "-", &(axKbOtherCases[j]));
+  }
+  if (xState.iCycleFd != -1)
+  {
+    close(xState.iCycleFd);
+  }
+  ADT_MemFree(&(xState.xCompMem));
+  ADT_MemFree(&(xState.xMem));
+
+  return 0;
+}
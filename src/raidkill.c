@@ -14,6 +14,27 @@
 // to just guess something for the kill buffer size.
 #define ADT_RK_KILL_BUF_SIZE ((uint32_t)((ADT_BYTES_IN_MEBIBYTE) / 2))
 
+// Where the known metadata lives, see bRK_ScanRaid()
+#define ADT_RK_MAX_SIGNATURES ((uint32_t)32)
+#define ADT_RK_SECTOR_SIZE ((uint32_t)512)
+#define ADT_RK_MD_MAGIC ((uint32_t)0xa92b4efc)
+#define ADT_RK_MD_SB_SIZE ((uint32_t)4096)
+#define ADT_RK_MD_090_ALIGN ((uint64_t)65536)
+#define ADT_RK_DDF_MAGIC ((uint32_t)0xde11de11)
+#define ADT_RK_DDF_PRIMARY_POS ((uint32_t)96)
+#define ADT_RK_DDF_SECONDARY_POS ((uint32_t)104)
+#define ADT_RK_IMSM_SIG "Intel Raid ISM Cfg Sig. "
+#define ADT_RK_IMSM_SIZE_POS ((uint32_t)36)
+#define ADT_RK_IMSM_MAX_SIZE (((uint32_t)128) * ADT_BYTES_IN_KIBIBYTE)
+#define ADT_RK_LVM_LABEL "LABELONE"
+#define ADT_RK_LVM_TYPE "LVM2 001"
+#define ADT_RK_LVM_TYPE_POS ((uint32_t)24)
+#define ADT_RK_LVM_LABEL_SECTORS ((uint32_t)4)
+#define ADT_RK_GPT_SIG "EFI PART"
+#define ADT_RK_GPT_ALTERNATE_POS ((uint32_t)32)
+#define ADT_RK_MBR_TYPE_POS ((uint32_t)450)
+#define ADT_RK_MBR_TYPE_GPT ((uint8_t)0xee)
+
 
 
 typedef struct
@@ -21,6 +42,10 @@ typedef struct
   uint8_t u8Silent;
   uint8_t u8Write;
   uint8_t u8Read;
+  uint8_t u8Wipe;
+  uint8_t u8WipeWay;
+  uint8_t u8Metadata;
+  uint8_t u8Undefined;
   uint32_t u32BufSize;
   char sDevice[ADT_GEN_BUF_SIZE];
   uint64_t u64DevSizeBytes;
@@ -28,6 +53,25 @@ typedef struct
 } tDcState;
 
 
+typedef struct
+{
+  const char* sName;
+  uint64_t u64Offset;
+  uint32_t u32Bytes;
+
+} tRkSignature;
+
+
+typedef struct
+{
+  int iFd;
+  uint64_t u64DevSizeBytes;
+  uint32_t u32Count;
+  tRkSignature axFound[ADT_RK_MAX_SIGNATURES];
+
+} tRkScan;
+
+
 
 static uint8_t bDC_GetParams(int argc, char* argv[], tDcState* pxState)
 {
@@ -39,6 +83,10 @@ static uint8_t bDC_GetParams(int argc, char* argv[], tDcState* pxState)
   pxState->u8Silent = 0;
   pxState->u8Write = 1;
   pxState->u8Read = 1;
+  pxState->u8Wipe = 0;
+  pxState->u8WipeWay = ADT_WIPE_ZEROOUT;
+  pxState->u8Metadata = 0;
+  pxState->u8Undefined = 0;
   pxState->u32BufSize = ADT_RK_KILL_BUF_SIZE;
 
   memset(pxState->sDevice, 0, ADT_GEN_BUF_SIZE);
@@ -63,6 +111,20 @@ static uint8_t bDC_GetParams(int argc, char* argv[], tDcState* pxState)
     {
       pxState->u8Silent = 1;
     }
+    else if (strcmp("-m", argv[i]) == 0)
+    {
+      pxState->u8Metadata = 1;
+    }
+    else if ((strcmp("-W", argv[i]) == 0) && ((i + 1) < (argc - 1)))
+    {
+      i++;
+
+      if (!bADT_ParseWipe(argv[i], &(pxState->u8WipeWay)))
+      {
+	return 0;
+      }
+      pxState->u8Wipe = 1;
+    }
     else
     {
       // Wrong parameter
@@ -107,7 +169,8 @@ static uint8_t bRK_ReadRaid(tDcState* pxState)
   int iCompBeginResult = 0;
   int iCompEndResult = 0;
   
-  pCompBufMem = malloc(pxState->u32BufSize);
+  // What a killed area reads as
+  pCompBufMem = calloc(1, pxState->u32BufSize);
 
   if (pCompBufMem == NULL)
   {
@@ -193,6 +256,365 @@ static uint8_t bRK_ReadRaid(tDcState* pxState)
 
 
 
+// Kills one area, with -W the device is asked to do it itself
+static uint8_t bRK_KillArea(tDcState* pxState, int iFd, void* pKillBufMem,
+			    uint64_t u64Offset, uint32_t u32Bytes)
+{
+  uint8_t u8Used = 0;
+
+  if (!pxState->u8Wipe)
+  {
+    return ((lseek(iFd, u64Offset, SEEK_SET) != -1) &&
+	    (write(iFd, pKillBufMem, u32Bytes) == u32Bytes) &&
+	    (fsync(iFd) != -1));
+  }
+  if (!bADT_WipeRange(iFd, u64Offset, u32Bytes, pxState->u8WipeWay, &u8Used))
+  {
+    return 0;
+  }
+  if (!bADT_WipeReadsZero(iFd, u8Used))
+  {
+    // No use comparing to zeros later
+    pxState->u8Undefined = 1;
+  }
+  if (u8Used != pxState->u8WipeWay)
+  {
+    printf("Wipe by %s not supported, wrote zeros instead\n",
+	   sADT_WipeName(pxState->u8WipeWay));
+  }
+
+  return 1;
+}
+
+
+// Metadata fields are little-endian, except DDF which is big
+static uint32_t u32RK_Le32(const uint8_t* pu8Mem)
+{
+  return (((uint32_t)pu8Mem[0]) | (((uint32_t)pu8Mem[1]) << 8) |
+	  (((uint32_t)pu8Mem[2]) << 16) | (((uint32_t)pu8Mem[3]) << 24));
+}
+
+static uint64_t u64RK_Le64(const uint8_t* pu8Mem)
+{
+  return (((uint64_t)u32RK_Le32(pu8Mem)) | (((uint64_t)u32RK_Le32(pu8Mem + 4)) << 32));
+}
+
+static uint32_t u32RK_Be32(const uint8_t* pu8Mem)
+{
+  return ((((uint32_t)pu8Mem[0]) << 24) | (((uint32_t)pu8Mem[1]) << 16) |
+	  (((uint32_t)pu8Mem[2]) << 8) | ((uint32_t)pu8Mem[3]));
+}
+
+static uint64_t u64RK_Be64(const uint8_t* pu8Mem)
+{
+  return ((((uint64_t)u32RK_Be32(pu8Mem)) << 32) | ((uint64_t)u32RK_Be32(pu8Mem + 4)));
+}
+
+
+
+// Sector at the offset, 0 if it is not all on the device
+static uint8_t bRK_ReadSector(tRkScan* pxScan, uint64_t u64Offset, uint8_t* pu8Sector)
+{
+  if ((u64Offset > pxScan->u64DevSizeBytes) ||
+      ((pxScan->u64DevSizeBytes - u64Offset) < ADT_RK_SECTOR_SIZE))
+  {
+    return 0;
+  }
+
+  return (pread(pxScan->iFd, pu8Sector, ADT_RK_SECTOR_SIZE, u64Offset) == ADT_RK_SECTOR_SIZE);
+}
+
+
+
+static void RK_AddSignature(tRkScan* pxScan, const char* sName, uint64_t u64Offset, uint32_t u32Bytes)
+{
+  uint32_t i;
+
+  for (i = 0; i < pxScan->u32Count; i++)
+  {
+    if (pxScan->axFound[i].u64Offset == u64Offset)
+    {
+      // Same place found on another way
+      return;
+    }
+  }
+  if (pxScan->u32Count < ADT_RK_MAX_SIGNATURES)
+  {
+    pxScan->axFound[pxScan->u32Count].sName = sName;
+    pxScan->axFound[pxScan->u32Count].u64Offset = u64Offset;
+    pxScan->axFound[pxScan->u32Count].u32Bytes = u32Bytes;
+    pxScan->u32Count++;
+  }
+}
+
+
+
+// Linux md: 1.1 at the start, 1.2 at 4K, 1.0 8K to 12K from the end
+// and 0.90 in the last whole 64K block
+static void RK_FindMd(tRkScan* pxScan)
+{
+  uint8_t au8Sector[ADT_RK_SECTOR_SIZE];
+  uint64_t u64Size = pxScan->u64DevSizeBytes;
+  uint64_t au64Offsets[4] = { 0, 4096, 0, 0 };
+  uint32_t au32Versions[4] = { 1, 1, 1, 0 };
+  const char* asNames[4] = { "md 1.1", "md 1.2", "md 1.0", "md 0.90" };
+  uint32_t i;
+
+  if (u64Size < (2 * ADT_RK_MD_090_ALIGN))
+  {
+    return;
+  }
+  au64Offsets[2] = (u64Size - (2 * ADT_RK_MD_SB_SIZE)) & ~((uint64_t)ADT_RK_MD_SB_SIZE - 1);
+  au64Offsets[3] = (u64Size & ~(ADT_RK_MD_090_ALIGN - 1)) - ADT_RK_MD_090_ALIGN;
+
+  for (i = 0; i < 4; i++)
+  {
+    if (bRK_ReadSector(pxScan, au64Offsets[i], au8Sector) &&
+	(u32RK_Le32(au8Sector) == ADT_RK_MD_MAGIC) &&
+	(u32RK_Le32(au8Sector + 4) == au32Versions[i]))
+    {
+      RK_AddSignature(pxScan, asNames[i], au64Offsets[i], ADT_RK_MD_SB_SIZE);
+    }
+  }
+}
+
+
+
+// SNIA DDF: anchor in the last sector, pointing to the primary and
+// secondary headers
+static void RK_FindDdf(tRkScan* pxScan)
+{
+  uint8_t au8Anchor[ADT_RK_SECTOR_SIZE];
+  uint8_t au8Sector[ADT_RK_SECTOR_SIZE];
+  uint64_t u64Offset = pxScan->u64DevSizeBytes - ADT_RK_SECTOR_SIZE;
+  uint64_t u64Lba = 0;
+  uint32_t au32Positions[2] = { ADT_RK_DDF_PRIMARY_POS, ADT_RK_DDF_SECONDARY_POS };
+  uint32_t i;
+
+  if ((!bRK_ReadSector(pxScan, u64Offset, au8Anchor)) ||
+      (u32RK_Be32(au8Anchor) != ADT_RK_DDF_MAGIC))
+  {
+    return;
+  }
+  RK_AddSignature(pxScan, "DDF anchor", u64Offset, ADT_RK_SECTOR_SIZE);
+
+  for (i = 0; i < 2; i++)
+  {
+    u64Lba = u64RK_Be64(au8Anchor + au32Positions[i]);
+
+    // All ones when there is none
+    if ((u64Lba < (pxScan->u64DevSizeBytes / ADT_RK_SECTOR_SIZE)) &&
+	bRK_ReadSector(pxScan, u64Lba * ADT_RK_SECTOR_SIZE, au8Sector) &&
+	(u32RK_Be32(au8Sector) == ADT_RK_DDF_MAGIC))
+    {
+      RK_AddSignature(pxScan, "DDF header", u64Lba * ADT_RK_SECTOR_SIZE, ADT_RK_SECTOR_SIZE);
+    }
+  }
+}
+
+
+
+// Intel Matrix (IMSM): second last sector, a big one continues in
+// the sectors before it
+static void RK_FindImsm(tRkScan* pxScan)
+{
+  uint8_t au8Sector[ADT_RK_SECTOR_SIZE];
+  uint64_t u64Offset = pxScan->u64DevSizeBytes - (2 * ADT_RK_SECTOR_SIZE);
+  uint32_t u32Bytes = 0;
+
+  if ((pxScan->u64DevSizeBytes < (2 * ADT_RK_SECTOR_SIZE)) ||
+      (!bRK_ReadSector(pxScan, u64Offset, au8Sector)) ||
+      (memcmp(au8Sector, ADT_RK_IMSM_SIG, strlen(ADT_RK_IMSM_SIG)) != 0))
+  {
+    return;
+  }
+  u32Bytes = u32RK_Le32(au8Sector + ADT_RK_IMSM_SIZE_POS);
+  u32Bytes = ((u32Bytes > ADT_RK_IMSM_MAX_SIZE) ? ADT_RK_IMSM_MAX_SIZE : u32Bytes);
+  u32Bytes = ((u32Bytes + ADT_RK_SECTOR_SIZE - 1) / ADT_RK_SECTOR_SIZE) * ADT_RK_SECTOR_SIZE;
+  u32Bytes = ((u32Bytes < ADT_RK_SECTOR_SIZE) ? ADT_RK_SECTOR_SIZE : u32Bytes);
+  u32Bytes = ((u32Bytes > (u64Offset + ADT_RK_SECTOR_SIZE)) ?
+	      (uint32_t)(u64Offset + ADT_RK_SECTOR_SIZE) : u32Bytes);
+  RK_AddSignature(pxScan, "IMSM", u64Offset + ADT_RK_SECTOR_SIZE - u32Bytes, u32Bytes);
+}
+
+
+
+// LVM physical volume label, in one of the first four sectors
+static void RK_FindLvm(tRkScan* pxScan)
+{
+  uint8_t au8Sector[ADT_RK_SECTOR_SIZE];
+  uint32_t i;
+
+  for (i = 0; i < ADT_RK_LVM_LABEL_SECTORS; i++)
+  {
+    if (bRK_ReadSector(pxScan, i * ADT_RK_SECTOR_SIZE, au8Sector) &&
+	(memcmp(au8Sector, ADT_RK_LVM_LABEL, strlen(ADT_RK_LVM_LABEL)) == 0) &&
+	(memcmp(au8Sector + ADT_RK_LVM_TYPE_POS, ADT_RK_LVM_TYPE, strlen(ADT_RK_LVM_TYPE)) == 0))
+    {
+      RK_AddSignature(pxScan, "LVM PV label", i * ADT_RK_SECTOR_SIZE, ADT_RK_SECTOR_SIZE);
+    }
+  }
+}
+
+
+
+// GPT header in the second LBA, backup in the last or where the
+// header says. LBAs may be 512 or 4096 bytes, so both are tried.
+// The protective MBR goes too, or it looks like a broken GPT.
+static void RK_FindGpt(tRkScan* pxScan)
+{
+  uint8_t au8Sector[ADT_RK_SECTOR_SIZE];
+  uint32_t au32LbaSizes[2] = { 512, 4096 };
+  uint64_t u64Offset = 0;
+  uint32_t u32Found = pxScan->u32Count;
+  uint32_t i;
+
+  for (i = 0; i < 2; i++)
+  {
+    if (bRK_ReadSector(pxScan, au32LbaSizes[i], au8Sector) &&
+	(memcmp(au8Sector, ADT_RK_GPT_SIG, strlen(ADT_RK_GPT_SIG)) == 0))
+    {
+      RK_AddSignature(pxScan, "GPT header", au32LbaSizes[i], ADT_RK_SECTOR_SIZE);
+      u64Offset = u64RK_Le64(au8Sector + ADT_RK_GPT_ALTERNATE_POS);
+
+      if ((u64Offset < (pxScan->u64DevSizeBytes / au32LbaSizes[i])) &&
+	  bRK_ReadSector(pxScan, u64Offset * au32LbaSizes[i], au8Sector) &&
+	  (memcmp(au8Sector, ADT_RK_GPT_SIG, strlen(ADT_RK_GPT_SIG)) == 0))
+      {
+	RK_AddSignature(pxScan, "GPT backup header", u64Offset * au32LbaSizes[i],
+			ADT_RK_SECTOR_SIZE);
+      }
+    }
+    // Backup may well outlive the primary
+    u64Offset = pxScan->u64DevSizeBytes - au32LbaSizes[i];
+
+    if ((pxScan->u64DevSizeBytes >= au32LbaSizes[i]) &&
+	bRK_ReadSector(pxScan, u64Offset, au8Sector) &&
+	(memcmp(au8Sector, ADT_RK_GPT_SIG, strlen(ADT_RK_GPT_SIG)) == 0))
+    {
+      RK_AddSignature(pxScan, "GPT backup header", u64Offset, ADT_RK_SECTOR_SIZE);
+    }
+  }
+  if ((pxScan->u32Count > u32Found) && bRK_ReadSector(pxScan, 0, au8Sector) &&
+      (au8Sector[ADT_RK_SECTOR_SIZE - 2] == 0x55) && (au8Sector[ADT_RK_SECTOR_SIZE - 1] == 0xaa) &&
+      (au8Sector[ADT_RK_MBR_TYPE_POS] == ADT_RK_MBR_TYPE_GPT))
+  {
+    RK_AddSignature(pxScan, "GPT protective MBR", 0, ADT_RK_SECTOR_SIZE);
+  }
+}
+
+
+
+// Looks for the metadata of all known kinds and lists what was found
+static uint8_t bRK_ScanRaid(tDcState* pxState, tRkScan* pxScan)
+{
+  uint32_t i;
+
+  memset(pxScan, 0, sizeof(*pxScan));
+  pxScan->u64DevSizeBytes = pxState->u64DevSizeBytes;
+  pxScan->iFd = open(pxState->sDevice, O_RDONLY);
+
+  if (pxScan->iFd == -1)
+  {
+    printf("Error: Unable to open the device in read mode\n");
+
+    return 0;
+  }
+  RK_FindMd(pxScan);
+  RK_FindDdf(pxScan);
+  RK_FindImsm(pxScan);
+  RK_FindLvm(pxScan);
+  RK_FindGpt(pxScan);
+  close(pxScan->iFd);
+  pxScan->iFd = -1;
+
+  if (pxScan->u32Count == 0)
+  {
+    printf("No known RAID signatures found\n");
+  }
+  else
+  {
+    printf("Found %u signatures:\n", pxScan->u32Count);
+  }
+  for (i = 0; i < pxScan->u32Count; i++)
+  {
+    printf("%-20s at byte %" PRIu64 " (%u bytes)\n", pxScan->axFound[i].sName,
+	   pxScan->axFound[i].u64Offset, pxScan->axFound[i].u32Bytes);
+  }
+
+  return 1;
+}
+
+
+
+// Wipes exactly what the scan found, in whole logical blocks
+static uint8_t bRK_KillFound(tDcState* pxState, tRkScan* pxScan)
+{
+  void* pKillBufMem = NULL;
+  int iFd = -1;
+  uint64_t u64Begin = 0;
+  uint64_t u64End = 0;
+  uint32_t u32BlockSize = 0;
+  uint32_t i;
+
+  if (pxState->u8Wipe && (pxState->u8WipeWay != ADT_WIPE_ZEROOUT) &&
+      (pxState->u8WipeWay != ADT_WIPE_WRITE))
+  {
+    // Single sectors are far below any discard granularity,
+    // the kernel would just leave them be
+    printf("Discard does not work on single sectors, using zeroout\n");
+    pxState->u8WipeWay = ADT_WIPE_ZEROOUT;
+  }
+
+  pKillBufMem = calloc(1, pxState->u32BufSize);
+
+  if (pKillBufMem == NULL)
+  {
+    printf("Error: Malloc failed\n");
+
+    return 0;
+  }
+  iFd = open(pxState->sDevice, O_WRONLY);
+
+  if (iFd == -1)
+  {
+    printf("Error: Unable to open the device in write mode\n");
+    free(pKillBufMem);
+
+    return 0;
+  }
+  // 512 byte ranges do not go on 4Kn disks
+  bADT_GetBlockSize(iFd, &u32BlockSize);
+
+  for (i = 0; i < pxScan->u32Count; i++)
+  {
+    u64Begin = pxScan->axFound[i].u64Offset;
+    u64Begin -= (u64Begin % u32BlockSize);
+    u64End = pxScan->axFound[i].u64Offset + pxScan->axFound[i].u32Bytes;
+    u64End = ((u64End + u32BlockSize - 1) / u32BlockSize) * u32BlockSize;
+    u64End = ((u64End > pxState->u64DevSizeBytes) ? pxState->u64DevSizeBytes : u64End);
+    u64End = (((u64End - u64Begin) > pxState->u32BufSize) ?
+	      (u64Begin + pxState->u32BufSize) : u64End);
+
+    if (!bRK_KillArea(pxState, iFd, pKillBufMem, u64Begin, (uint32_t)(u64End - u64Begin)))
+    {
+      printf("Error: Unable to wipe %s (%" PRIu64 ")\n", pxScan->axFound[i].sName, u64Begin);
+      free(pKillBufMem);
+      close(iFd);
+
+      return 0;
+    }
+    printf("Wiped %u bytes of %s (%" PRIu64 ")\n", (uint32_t)(u64End - u64Begin),
+	   pxScan->axFound[i].sName, u64Begin);
+  }
+  free(pKillBufMem);
+  close(iFd);
+
+  return 1;
+}
+
+
+
 static uint8_t bRK_KillRaid(tDcState* pxState)
 {
   // Various vendors have different specifications for RAID, some
@@ -202,7 +624,7 @@ static uint8_t bRK_KillRaid(tDcState* pxState)
   void* pKillBufMem = NULL;
   int iFd = -1;
 
-  pKillBufMem = malloc(pxState->u32BufSize);
+  pKillBufMem = calloc(1, pxState->u32BufSize);
 
   if (pKillBufMem == NULL)
   {
@@ -221,9 +643,7 @@ static uint8_t bRK_KillRaid(tDcState* pxState)
   }
 
   // Seek, write and flush the beginning
-  if ((lseek(iFd, 0, SEEK_SET) == -1) ||
-      (write(iFd, pKillBufMem, pxState->u32BufSize) != pxState->u32BufSize) ||
-      (fsync(iFd) == -1))
+  if (!bRK_KillArea(pxState, iFd, pKillBufMem, 0, pxState->u32BufSize))
   {
     printf("Error: Unable to write to the beginning (%" PRIu64 ")\n", (uint64_t)0);
     free(pKillBufMem);
@@ -235,9 +655,8 @@ static uint8_t bRK_KillRaid(tDcState* pxState)
 	 pxState->u32BufSize, (uint64_t)0);
 
   // Seek, write and flush the end
-  if ((lseek(iFd, (pxState->u64DevSizeBytes - pxState->u32BufSize), SEEK_SET) == -1) ||
-      (write(iFd, pKillBufMem, pxState->u32BufSize) != pxState->u32BufSize) ||
-      (fsync(iFd) == -1))
+  if (!bRK_KillArea(pxState, iFd, pKillBufMem, (pxState->u64DevSizeBytes - pxState->u32BufSize),
+		    pxState->u32BufSize))
   {
     printf("Error: Unable to write to the end (%" PRIu64 ")\n",
 	   (pxState->u64DevSizeBytes - pxState->u32BufSize));
@@ -265,6 +684,7 @@ int main(int argc, char* argv[])
   int iFd = -1;
   int iTemp = 0;
   tDcState xState;
+  tRkScan xScan;
   char sReadBuf[ADT_GEN_BUF_SIZE] = { 0 };
   char sSizeHumReadBuf[ADT_GEN_BUF_SIZE] = { 0 };
   char sModel[ADT_DISK_INFO_MODEL_LEN + 1] = { 0 };
@@ -275,7 +695,7 @@ int main(int argc, char* argv[])
   if (!bDC_GetParams(argc, argv, &xState))
   {
     printf("Error: Params failure, use:\n");
-    printf("diskcont [-w] [-r] [-s] /path/to/device\n");
+    printf("raidkill [-w] [-r] [-s] [-m] [-W zeroout|discard|secure|write] /path/to/device\n");
 
     return 1;
   }
@@ -299,7 +719,19 @@ int main(int argc, char* argv[])
   ADT_BytesToHumanReadable(xState.u64DevSizeBytes, sSizeHumReadBuf);
   printf("Found device %s   %s\n", xState.sDevice, sSizeHumReadBuf);
   printf("Model: %s   Serial: %s\n", sModel, sSerial);
-  
+
+  if (xState.u8Metadata)
+  {
+    // Report first, so -r alone is a dry run
+    if (!bRK_ScanRaid(&xState, &xScan))
+    {
+      return 1;
+    }
+    if (xState.u8Write && (xScan.u32Count == 0))
+    {
+      return 0;
+    }
+  }
   if (xState.u8Write)
   {
     // Write test
@@ -317,12 +749,35 @@ int main(int argc, char* argv[])
 	return 1;
       }
     }
-    if (!bRK_KillRaid(&xState))
+    if (xState.u8Metadata ? (!bRK_KillFound(&xState, &xScan)) : (!bRK_KillRaid(&xState)))
+    {
+      return 1;
+    }
+  }
+  if (xState.u8Metadata && xState.u8Read)
+  {
+    if (xState.u8Write)
+    {
+      printf("Scanning again\n");
+
+      if (!bRK_ScanRaid(&xState, &xScan))
+      {
+	return 1;
+      }
+    }
+    if (xScan.u32Count > 0)
     {
+      printf("Raid might still be active!\n");
+
       return 1;
     }
+    printf("Raid successfully verified killed\n");
+  }
+  else if (xState.u8Read && xState.u8Undefined)
+  {
+    printf("Data after discard is undefined, not compared\n");
   }
-  if (xState.u8Read)
+  else if (xState.u8Read)
   {
     if (!bRK_ReadRaid(&xState))
     {